@@ -9,416 +9,115 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "fru_sup.h"
+#include "fru_cache.h"
+#include "fru_file.h"
+#include "fru_manifest.h"
+#include "fru_scan.h"
+#include "fru_report.h"
+#include "fru_eeprom.h"
 #include "ocslog.h"
 
 /*#define DEBUG*/
 
-/* end move to i2c library */
-static int read_from_eeprom(uint8_t channel, uint8_t slave_addr);
-static int write_to_eeprom(uint8_t channel, uint8_t slave_addr, uint16_t fru_offset, uint16_t write_length, uint8_t* buffer);
-
-/* debug buffer */
-uint8_t *debug_buffer;
-
-
-/* function pointer for i2c write read */
-int(*i2c_write_read)(int32_t handle,
-	uint8_t slave_addr,
-	uint8_t write_length,
-	uint8_t* write_data,
-	uint8_t read_length,
-	uint8_t* buffer);
-
-/* function pointer for i2c write */
-int(*i2c_write)(int32_t handle,
-	uint8_t slave_addr,
-	uint8_t write_length,
-	uint8_t* write_data,
-	uint8_t data_length,
-	uint8_t* data);
-
-
 /*
-	Required FRU fields.  These tags must appear in the FRU file.
+	a text file is printable, a binary image starts with the format
+	version byte, 1 or 0 on legacy images, whatever its check sums.
 */
-static const uint8_t FRU_FIELDS[MAX_RECORDS][MAX_NAME_LEN] = {
-	"Board_MfgTime:",		/* 00 */
-	"Board_MfgName:",		/* 01 */
-	"Board_Product:",		/* 02 */
-	"Board_Serial:",		/* 03 */
-	"Board_PartNumber:",	/* 04 */
-	"Board_FruId:",			/* 05 */
-	"Board_BinaryAdd:",		/* 06 */
-	"Board_BinaryAdd:",		/* 07 */
-	"Board_Version:",		/* 08 */
-	"Board_Build:",			/* 09 */
-	"Product_Mfgr:",		/* 10 */
-	"Product_Product:",		/* 11 */
-	"Product_Model:",		/* 12 */
-	"Product_Serial:",		/* 13 */
-	"Product_AssetTag:",	/* 14 */
-	"Product_FruId:",		/* 15 */
-	"Product_SubProd:",		/* 16 */
-	"Product_Build:"		/* 17 */
-};
-
-/* converts input char buffer to binary data */
-static int convert_binary_data(uint8_t* buffer) {
-
-	if (buffer == NULL)
-		return FAILURE;
-
-	uint64_t hex = strtoul(buffer, NULL, 16);
-	memset(buffer, 0, sizeof(long));
-
-	memcpy(buffer, &hex, sizeof(long));
-
-	return SUCCESS;
-}
-
-/*
-requited fru fields.  tags must appear in the fru file.
-*/
-static AREA_FIELD fru_field(uint16_t *idx, uint8_t *buffer)
+static int is_fru_image(FILE *input)
 {
-	AREA_FIELD field;
+	uint8_t header[sizeof(FRU_HEADER)];
+	size_t size;
+	size_t i;
+	int image = 0;
+
+	size = fread(header, 1, sizeof(header), input);
 
-	field.length = &buffer[++(*idx)];
-	field.data = &buffer[++(*idx)];
+	for (i = 0; i < size && !image; i++)
+		image = (header[i] < ' ' && header[i] != '\t' && header[i] != '\n' && header[i] != '\r') ||
+			header[i] == 0x7F;
 
-	*idx += *field.length;
+	rewind(input);
 
-	return field;
+	return image;
 }
 
 /*
-	assigns fru charactor data in buffer to fru structures.
+	loads a binary eeprom image, such as one saved by -r raw, and checks
+	the header and every area check sum so a damaged image is never
+	written, unless force is set.
 */
-static int read_fru_from_buffer(uint8_t *buffer, uint16_t length)
+static int load_fru_image(FILE *input, uint8_t *fru_data, uint16_t *length, uint8_t force)
 {
-	uint16_t idx;
-	uint8_t * mfgtime;
-
-	FRU_HEADER header;
-	memset(&header, 0, sizeof(FRU_HEADER));
-
-	FRU_BOARD_INFO board;
-	memset(&board, 0, sizeof(FRU_BOARD_INFO));
-
-	FRU_PRODUCT_INFO product;
-	memset(&product, 0, sizeof(FRU_PRODUCT_INFO));
-
-	/* populate fru header */
-	memcpy(&header, buffer, sizeof(FRU_HEADER));
-
-	/* index into board area */
-	idx = (header.board * 8);
-
-	if (idx + sizeof(FRU_HEADER) > length) {
-		log_fnc_err(UNKNOWN_ERROR, "FRU buffer lenght does not support board header data");
-		return FAILURE;
+	FRU_INDEX index;
+	size_t size;
+	uint8_t failed = 0;
+	uint8_t area;
+
+	size = fread(fru_data, 1, MAX_EEPROM_SZ, input);
+	if (size == MAX_EEPROM_SZ && fgetc(input) != EOF) {
+		log_fnc_err(UNKNOWN_ERROR, "image larger than the %d byte eeprom", MAX_EEPROM_SZ);
+		return UNKNOWN_ERROR;
 	}
 
-	/* board header information */
-	board.header.version = buffer[idx++];
-	board.header.length = buffer[idx++];
-	board.header.languagecode = buffer[idx++];
-
-	if (idx + (board.header.length - sizeof(FRU_HEADER)) > length) {
-		log_fnc_err(UNKNOWN_ERROR, "FRU buffer lenght does not support board area data");
-		return FAILURE;
+	if (fru_index_build(fru_data, (uint16_t)size, &index) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "image too short");
+		return UNKNOWN_ERROR;
 	}
 
-	// temporary for mftdatetime
-	mfgtime = array_to_time(&buffer[idx]);
-	log_out("board mfgdatetime: %s \n", mfgtime);
-	idx += 2;
-
-	board.manufacture = fru_field(&idx, buffer);
-	log_out("board manufacturer: %s \n", board.manufacture.data);
-
-	board.name = fru_field(&idx, buffer);
-	log_out("board name: %s \n", board.name.data);
-
-	board.serial = fru_field(&idx, buffer);
-	log_out("board serial: %s \n", board.serial.data);
-
-	board.part = fru_field(&idx, buffer);
-	log_out("board part: %s \n", board.part.data);
-
-	board.fruid = fru_field(&idx, buffer);
-	log_out("board fruId: %s \n", board.fruid.data);
-
-	board.address1 = fru_field(&idx, buffer);
-	if (*board.address1.length > 0) {
-		log_out("board address1: %s \n", board.address1.data);
+	if (index.header_status != FRU_AREA_OK) {
+		log_out("image common header failed its check\n");
+		failed = 1;
 	}
 
-	board.address2 = fru_field(&idx, buffer);
-	if (*board.address2.length > 0) {
-		log_out("board address2: %s \n", board.address2.data);
+	/* areas left present start past the end of the image */
+	for (area = 0; area < FRU_AREA_COUNT; area++) {
+		if (index.area[area].status != FRU_AREA_ABSENT && index.area[area].status != FRU_AREA_OK) {
+			log_out("image %s area at %d failed its check\n", fru_area_name(area), index.area[area].offset);
+			failed = 1;
+		}
 	}
 
-	board.boardver = fru_field(&idx, buffer);
-	log_out("board version: %s \n", board.boardver.data);
-
-	board.build = fru_field(&idx, buffer);
-	log_out("board build: %s \n", board.build.data);
-
-	/* index into product area */
-	idx = (header.product * 8);
-
-	if (idx + sizeof(FRU_HEADER) > length) {
-		log_fnc_err(UNKNOWN_ERROR, "FRU buffer lenght does not support product header data");
-		return FAILURE;
+	if (failed && !force) {
+		log_fnc_err(UNKNOWN_ERROR, "image check sums failed, -f writes it anyway");
+		return UNKNOWN_ERROR;
 	}
 
-	/* product header information */
-	product.header.version = buffer[idx++];
-	product.header.length = buffer[idx++];
-	product.header.languagecode = buffer[idx];
-
-	if (idx + (product.header.length - sizeof(FRU_HEADER)) > length) {
-		log_fnc_err(UNKNOWN_ERROR, "FRU buffer lenght does not support product area data");
-		return FAILURE;
-	}
-
-	product.manufacture = fru_field(&idx, buffer);
-	log_out("product manufacture: %s \n", product.manufacture.data);
-
-	product.productname = fru_field(&idx, buffer);
-	log_out("product productname: %s \n", product.productname.data);
-
-	product.productversion = fru_field(&idx, buffer);
-	log_out("product productversion: %s \n", product.productversion.data);
-
-	product.serial = fru_field(&idx, buffer);
-	log_out("product serial: %s \n", product.serial.data);
-
-	product.assettag = fru_field(&idx, buffer);
-	log_out("product assettag: %s \n", product.assettag.data);
-
-	product.fruid = fru_field(&idx, buffer);
-	log_out("product fruid: %s \n", product.fruid.data);
-
-	product.subproduct = fru_field(&idx, buffer);
-	log_out("product subproduct: %s \n", product.subproduct.data);
-
-	product.build = fru_field(&idx, buffer);
-	log_out("product build: %s \n", product.build.data);
+	*length = (uint16_t)size;
 
 	return SUCCESS;
 }
 
 /*
-	reads fru text data from file into array
+	reads fru text data or a binary image from file into array and
+	writes it to eeprom, either in full or only the pages that differ
+	from the device.
 */
-static int read_fru_from_file(uint8_t channel, uint8_t slave_addr, FILE *input)
+static int read_fru_from_file(uint8_t channel, uint8_t slave_addr, FILE *input, uint8_t diff_write,
+	uint8_t verify, uint8_t force)
 {
-	/* fru spec rev 1.3: field lenght: 5:0 */
-	/* record maximum lenght 63 bytes */
-	uint8_t line[80];
-	memset(&line, 0, sizeof(line));
-
-	/* used for line tag compare */
-	uint8_t tag[MAX_NAME_LEN];
-	memset(&tag, 0, MAX_NAME_LEN);
-
-	uint8_t tag_length = 0;
-	uint8_t field_length = 0;
-	uint16_t area_length = 0;
-	uint16_t idx = sizeof(FRU_HEADER);
-
-	FRU_HEADER header;
-	memset(&header, 0, sizeof(FRU_HEADER));
+	uint16_t length = 0;
+	int rc = 0;
 
 	uint8_t *fru_data;
 	fru_data = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
 
-	uint8_t *boardLength;
-	uint8_t *prodLength;
-
-	fru_data[idx++] = FRU_VERSION;
-	boardLength = &fru_data[idx++];
-	fru_data[idx++] = FRU_LANG;
-	area_length = 3;
-	int rc = 0;
-
-	size_t i;
-	for (i = 0; i < MAX_RECORDS; i++)
-	{
-		if (fgets(line, (MAX_LENGTH + MAX_NAME_LEN), input) != NULL)
-		{
-			if (strstr(&line, &FRU_FIELDS[i]) != NULL) {
-
-				tag_length = (uint8_t)strlen(&FRU_FIELDS[i]);
-
-				memset(&tag, 0, MAX_NAME_LEN);
-				strncpy(&tag, &FRU_FIELDS[i], tag_length);
-
-				/* check fru file tag format */
-				if (strcmp(&tag, &FRU_FIELDS[i]) != 0)
-				{
-					log_fnc_err(UNKNOWN_ERROR, "header mismatch line beginging: %s\n", line);
-					rc = UNKNOWN_ERROR;
-					break;
-				}
-
-				/* length of field or maximum length */
-				field_length = (uint8_t)((strlen(line) - tag_length));
-				field_length = field_length > MAX_LENGTH ? MAX_LENGTH : field_length;
-
-				/* remove any new line */
-				if (field_length > 0) {
-					field_length = line[(field_length + tag_length) - 1] == NEW_LINE ?
-						field_length - 1 : field_length;
-				}
-
-				/* if mfgdate time is not specified, use current time*/
-				if (i == 0){
-
-					uint32_t mfg_time = 0;
-
-					/* no date use current */
-					if (field_length == 0)
-						mfg_time = current_time();
-					else{
-						if (field_length > 20);
-							field_length = 20;
-
-						char date_str[20];
-						strncpy(&date_str, &line[tag_length], field_length);
-						mfg_time = str_time_to_array(&date_str);
-					}
-
-					if (mfg_time > 0) {
-						memcpy(&fru_data[idx], &mfg_time, 3);
-						idx += 3;
-						area_length += 3;
-					}
-					else {
-						log_fnc_err(UNKNOWN_ERROR, "could not get current time.");
-						rc = UNKNOWN_ERROR;
-						break;
-					}
-				} /* board_binary */
-				//else if (i == 6 || i == 7) {
-
-				//	uint8_t binary_data[20];
-
-				//if (field_length > 0)
-				//{
-				//	/* typically mac address space */
-				//	field_length = (field_length - remove_char(&line[tag_length], '-'));
-				//	field_length = (field_length - remove_char(&line[tag_length], ':'));
-				//	/* copy data to temp buffer */
-				//	strncpy(&binary_data, &line[tag_length], field_length);
-				//
-				//	/* convert data to binary data */
-				//	convert_binary_data(&binary_data);
-				//
-				//	/*every hex charactor is 2 */
-				//	field_length = (field_length / 2);
-				////}
-				//
-				///* copy field data into buffer */
-				//fru_data[idx++] = (uint8_t)(field_length & FRU_LENGTH_MASK);
-				//strncpy(&fru_data[idx++], &binary_data, field_length);
-				//
-				///* increment index by the field length */
-				//idx += field_length;
-				//
-				///* increment the area length, by the field lenght and the bytes occupied */
-				//area_length += (field_length + 2);
-				//
-				//}
-				/* check current area within designated fru size */
-				else if (fru_oversize(idx, field_length + 1)) {
-
-					/* copy field data into buffer */
-					fru_data[idx++] = (uint8_t)(field_length & FRU_LENGTH_MASK);
-					strncpy(&fru_data[idx++], &line[tag_length], field_length);
-
-					/* increment index by the field length */
-					idx += field_length;
-
-					/* increment the area length, by the field lenght and the bytes occupied */
-					area_length += (field_length + 2);
-				}
-				else {
-					log_fnc_err(UNKNOWN_ERROR, "content to large for FRU designated EEPROM space: %s", line);
-					rc = UNKNOWN_ERROR;
-					break;
-				}
-
-				tag_length = 0;
-				field_length = 0;
-
-				if (i == (9)
-					|| i == (MAX_RECORDS - 1)) {
-
-					area_length++; // stop byte
-					area_length++; // checksum
-
-					/* area stop byte */
-					fru_data[idx++] = FRU_AREA_STOP;
-
-					/* check sum */
-					idx++;
-
-					/* pad area length */
-					if ((area_length % 8) != 0) {
-						idx += (8 - (area_length % 8));
-						area_length += (8 - (area_length % 8));
-					}
-
-					/* start of board area */
-					if (i == 9) {
-						header.board = 1;
-						*boardLength = (uint8_t)(area_length /8);
-
-						header.product = (uint8_t)(idx / 8);
-
-						fru_data[idx++] = FRU_VERSION;
-						prodLength = &fru_data[idx++];
-						fru_data[idx++] = FRU_LANG;
-
-						area_length = 3;
-
-						/* zero the area length for next area */
-					}
-					else {
-						*prodLength = (uint8_t)(area_length /8);
-					}
-				}
-			}
-			else {
-				log_fnc_err(UNKNOWN_ERROR, "could not read line header: %s", line);
-				rc = UNKNOWN_ERROR;
-				break;
-			}
-
-		}
-		else {
-			log_fnc_err(UNKNOWN_ERROR, "file not in correct format: %s \n", line);
-			rc = UNKNOWN_ERROR;
-			break;
-		}
-	}
+	/* images are written byte for byte, text is encoded */
+	if (is_fru_image(input))
+		rc = load_fru_image(input, fru_data, &length, force);
+	else
+		rc = encode_fru_file(input, fru_data, &length);
 
 	if (rc == SUCCESS)
 	{
-
-		/* copy the header */
-		memcpy(fru_data, &header, sizeof(FRU_HEADER));
-
 #ifdef DEBUG
 
 		print_msg("read input file buffer", NULL);
 
 		/* read file back */
-		rc = read_fru_from_buffer(fru_data, idx);
+		rc = read_fru_from_buffer(fru_data, length);
 
 		print_msg("read buffer", &rc);
 
@@ -429,371 +128,379 @@ static int read_fru_from_file(uint8_t channel, uint8_t slave_addr, FILE *input)
 		{
 			uint16_t fru_offset = 0;
 			print_msg("write to eeprom", NULL);
-			rc = write_to_eeprom(channel, slave_addr, fru_offset, idx, fru_data);
+			if (diff_write)
+				rc = write_changed_pages(channel, slave_addr, length, fru_data);
+			else
+				rc = write_to_eeprom(channel, slave_addr, fru_offset, length, fru_data);
 			print_msg("write", &rc);
+
+			/* a failed write leaves pages the read back will find */
+			if (verify)
+				rc = verify_write(channel, slave_addr, length, fru_data);
 		}
 	}
 	free(fru_data);
 	return rc;
 }
 
-/* debug simulating i2c_write_read */
-static int i2c_write_read_dbg(int32_t handle, uint8_t slave_addr,
-	uint8_t write_length, uint8_t* write_data, uint8_t read_length, uint8_t* buffer)
-{
-	if (debug_buffer == NULL){
-		log_fnc_err(UNKNOWN_ERROR, "i2c_write_read_dbg - no debug buffer defined");
-		return FAILURE;
-	}
-	else{
-		uint16_t offset = 0;
-		memcpy(&offset, write_data, sizeof(uint16_t));
-		memcpy(buffer, &debug_buffer[offset], read_length);
-		return SUCCESS;
-	}
-}
+/*
+reads the whole eeprom in one pass and saves it byte for byte to path,
+or to stdout when path is NULL.  stdout gets the image alone, no text.
+*/
+static int read_raw_from_eeprom(uint8_t channel, uint8_t slave_addr, const char *path) {
 
-/* write read from i2c device */
-static int i2c_write_read_prod(int32_t handle, uint8_t slave_addr,
-	uint8_t write_length, uint8_t* write_data, uint8_t read_length, uint8_t* buffer)
-{
-	// switch msb->lsb
-	uint16_t offset = (uint16_t)(write_data[0]<<8|write_data[1]);
-	memcpy(write_data, &offset, sizeof(uint16_t));
+	uint8_t quiet = (path == NULL);
+	FILE *output = stdout;
 
-	if(i2c_block_read(handle, slave_addr, write_length, write_data, read_length, buffer)!= SUCCESS){
-		log_fnc_err(UNKNOWN_ERROR, "i2c read_after_write failed for eeprom: (%02x).\n", slave_addr);
-		return FAILURE;
-	}
+	if (!quiet)
+		print_msg("reading raw from eeprom", NULL);
 
-	return SUCCESS;
-}
+	uint8_t *buffer;
+	buffer = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
 
-/* debug simulating i2c_write */
-static int i2c_write_dbg(int32_t handle, uint8_t slave_addr,
-	uint8_t write_length, uint8_t* write_data, uint8_t data_length, uint8_t* data)
-{
-	if (debug_buffer == NULL){
-		log_out("i2c_write_read_dbg - no debug buffer defined");
-		return FAILURE;
-	}
-	else{
-		uint16_t offset = 0;
-		memcpy(&offset, write_data, sizeof(uint16_t));
-		memcpy(&debug_buffer[offset], data, data_length);
-		return SUCCESS;
-	}
-}
+	I2C_SEGMENT segments[MAX_SEGMENTS];
+	int count = 0;
+	int response = 0;
 
-/* write to i2c device */
-static int i2c_write_prod(int32_t handle, uint8_t slave_addr,
-	uint8_t write_length, uint8_t *write_data, uint8_t data_length, uint8_t *buffer)
-{
-		uint16_t offset = (uint16_t)(write_data[0]<<8 | write_data[1]);
-		memcpy(write_data, &offset, sizeof(uint16_t));
+	int32_t handle = 0;
+	// open i2c bus
+	if ((response = open_i2c_channel(channel, &handle)) != SUCCESS)
+		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
 
-		if(i2c_block_write(handle, slave_addr, write_length, write_data, data_length, buffer) != SUCCESS)
-		{
-				log_fnc_err(UNKNOWN_ERROR, "i2c write failed for eeprom (%02x).\n", slave_addr);
-				return FAILURE;
-		}
+	if (response == SUCCESS) {
+		count = plan_read_segments(0, MAX_EEPROM_SZ, buffer, segments, arr_size(segments));
 
-		return SUCCESS;
-}
+		if ((response = (*i2c_read_segments)(handle, slave_addr, (uint16_t)count, segments)) != SUCCESS)
+			log_fnc_err(UNKNOWN_ERROR, "read_raw_from_eeprom() i2c_read_segments failed.");
 
-/* supports fru read, by reading fru area from eeprom */
-static int read_fru_area(int32_t handle, uint8_t slave_addr, uint16_t *fru_offset,
-	uint16_t *buf_idx, int16_t *area_length, uint8_t *buffer)
-{
-	int response = SUCCESS;
-	uint16_t length = 0;
-	uint16_t boundary = 0;
-	uint16_t fru_idx = 0;
-	uint8_t read_length = 0;
-	uint8_t write_buffer[sizeof(uint16_t)];
+		close_i2c_channel(handle);
+	}
 
-	AREA_HEADER area_header;
-	memset(&area_header, 0, sizeof(AREA_HEADER));
+	if (response == SUCCESS && path != NULL && (output = fopen(path, "wb")) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "can't open output file: %s", path);
+		response = UNKNOWN_ERROR;
+	}
 
-	// copy the start offset to the write buffer
-	memset(&write_buffer, 0, sizeof(uint16_t));
-	memcpy(write_buffer, fru_offset, sizeof(uint16_t));
+	if (response == SUCCESS) {
+		if (fwrite(buffer, 1, MAX_EEPROM_SZ, output) != MAX_EEPROM_SZ)
+			response = UNKNOWN_ERROR;
 
-	/* ensure fru header is withn the page, or read across page boundaries */
-	if (MAX_PAGE_SIZE - (*fru_offset % MAX_PAGE_SIZE) > sizeof(AREA_HEADER)) {
-		response = (*i2c_write_read)(handle, slave_addr, (uint8_t)sizeof(uint16_t), write_buffer, sizeof(AREA_HEADER), &buffer[*buf_idx]);
+		if ((output == stdout ? fflush(output) : fclose(output)) != SUCCESS)
+			response = UNKNOWN_ERROR;
+
+		if (response != SUCCESS)
+			log_fnc_err(UNKNOWN_ERROR, "unable to write raw image");
 	}
-	else{
-		uint16_t i = 0;
-		uint16_t tmp_idx = *buf_idx;
-		uint16_t offset = *fru_offset;
-
-		for (; i < sizeof(area_header); i++) {
-			if (response = (*i2c_write_read)(handle, slave_addr, (uint8_t)sizeof(uint16_t), write_buffer, sizeof(uint8_t), &buffer[tmp_idx]) != SUCCESS) {
-				log_fnc_err(UNKNOWN_ERROR, "area head read error (%d)", response);
-				return FAILURE;
-			}
 
-			offset++;
-			tmp_idx++;
+	free(buffer);
 
-			memcpy(write_buffer, &offset, sizeof(uint16_t));
-		}
+	if (!quiet)
+		print_msg("eeprom read", &response);
 
-	}
+	return response;
+}
 
-	if (response == SUCCESS)
-	{
-		memcpy(&area_header, &buffer[*buf_idx], sizeof(AREA_HEADER));
-		*fru_offset += sizeof(AREA_HEADER);
-		*buf_idx += sizeof(AREA_HEADER);
+/*
+walks the fields of one area up to the last one wanted and reads the
+data of the wanted ones.  first and last are the fru_field_ids of the
+area's fields in area order.
+*/
+static int read_area_fields(EEPROM_READ_CTX *eeprom, uint16_t offset, uint16_t fixed,
+	uint8_t first, uint8_t last, const uint8_t *wanted)
+{
+	FRU_FIELD_READER reader;
+	FRU_FIELD_LOC loc;
+	AREA_FIELD field;
+	uint8_t data[FRU_FIELD_MAX];
+	char text[FRU_FIELD_TEXT_LEN];
+	uint8_t id = first;
+	int rc = SUCCESS;
 
-		*area_length += (area_header.length * 8);
-		if(*area_length > MAX_EEPROM_SZ/2)
-		{
-			log_fnc_err(UNKNOWN_ERROR, "area length (%d) exceeded %d\n", *area_length, MAX_EEPROM_SZ/2);
-			return FAILURE;
-		}
+	while (last > first && !wanted[last])
+		last--;
 
-		if (area_header.length != 0)
-		{
-			length = ((area_header.length * 8) - sizeof(AREA_HEADER));
+	if (fru_field_open(&reader, offset, fixed, eeprom_read, eeprom) != SUCCESS)
+		return FAILURE;
 
-			while (fru_idx < length)
-			{
-				// copy the start offset to the write buffer
-				memset(&write_buffer, 0, sizeof(uint16_t));
-				memcpy(write_buffer, fru_offset, sizeof(uint16_t));
+	for (id = first; id <= last; id++) {
+		if ((rc = fru_field_locate(&reader, &loc)) != SUCCESS)
+			break;
 
-				if ((fru_idx + MAX_PAYLOAD_LEN) < length)
-					read_length = MAX_PAYLOAD_LEN;
-				else
-					read_length = (length - fru_idx);
+		if (!wanted[id])
+			continue;
 
-				/* get page boundary */
-				boundary = MAX_PAGE_SIZE - (*fru_offset % MAX_PAGE_SIZE);
+		field.length = &loc.type_length;
+		field.data = data;
+		field.type = loc.type;
 
-				if (read_length > boundary)
-					read_length = boundary;
+		if (eeprom_read(eeprom, loc.offset, fru_field_length(&field), data) != SUCCESS)
+			return FAILURE;
 
-				if (read_length > 0)
-					if ((*i2c_write_read)(handle, slave_addr, (uint8_t)sizeof(uint16_t), write_buffer, read_length, &buffer[*buf_idx]) != SUCCESS)
-					{
-						log_fnc_err(UNKNOWN_ERROR, "read_fru_area() i2c_write_read failed.");
-						return FAILURE;
-					}
+		fru_field_text(&field, text, sizeof(text));
+		log_out("%s: %s\n", fru_file_tag(id), text);
+	}
 
-				fru_idx += read_length;
-				*fru_offset += read_length;
-				*buf_idx += read_length;
-			}
-		}
+	/* fields past the end of fields marker are absent */
+	for (; id <= last && rc == FRU_FIELD_DONE; id++) {
+		if (wanted[id])
+			log_out("%s: absent\n", fru_file_tag(id));
 	}
 
-	return response;
+	return rc == FAILURE ? FAILURE : SUCCESS;
 }
 
-/* reads raw fru data from eeprom */
-static int read_raw_from_eeprom(uint8_t channel, uint8_t slave_addr) {
+/*
+reads only the fields listed, such as Board_Serial,Product_AssetTag:
+the common header, the header of each area wanted, one type/length
+byte per field up to the last one wanted and the data of the wanted
+fields.  area check sums are not verified, that takes the whole area,
+and a common header check sum mismatch is only reported, as a full
+read does: legacy images carry no header check sum.  the first area
+that fails decides the result.
+*/
+static int read_fields(uint8_t channel, uint8_t slave_addr, char *list)
+{
+	EEPROM_READ_CTX eeprom;
+	FRU_HEADER header;
+	FRU_INDEX index;
+	uint8_t wanted[MAX_RECORDS];
+	uint8_t board = 0;
+	uint8_t product = 0;
+	uint8_t mfg_time[FRU_MFG_TIME_LEN];
+	char *save = NULL;
+	char *tag;
+	int response;
+	int rc;
+	int id;
+
+	memset(wanted, 0, sizeof(wanted));
 
-	print_msg("reading raw from eeprom", NULL);
+	for (tag = strtok_r(list, ",", &save); tag != NULL; tag = strtok_r(NULL, ",", &save)) {
+		if ((id = fru_file_tag_lookup(tag, strlen(tag))) < SUCCESS) {
+			log_fnc_err(UNKNOWN_ERROR, "unknown field: %s", tag);
+			usage();
+			return UNKNOWN_ERROR;
+		}
 
-	uint8_t *buffer;
-	buffer = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
+		/* both addresses share a tag */
+		wanted[id] = 1;
+		if (id == FIELD_BOARD_ADDRESS1)
+			wanted[FIELD_BOARD_ADDRESS2] = 1;
 
-	uint16_t fru_offset = 0;
-	uint16_t buf_idx = 0;
-	uint8_t  write_buffer[sizeof(uint16_t)];
+		if (id <= FIELD_BOARD_BUILD)
+			board = 1;
+		else
+			product = 1;
+	}
 
-	int response = 0;
-	uint8_t read_length = 0;
-	// copy the start offset to the write buffer
-	memcpy(write_buffer, &fru_offset, sizeof(uint16_t));
+	memset(&eeprom, 0, sizeof(EEPROM_READ_CTX));
+	eeprom.slave_addr = slave_addr;
 
-	int32_t handle = 0;
-	// open i2c bus
-	if ((response = open_i2c_channel(channel, &handle)) != SUCCESS)
+	if ((response = open_i2c_channel(channel, &eeprom.handle)) != SUCCESS) {
 		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
+		return response;
+	}
 
-	log_out("\n");
-	if (response == SUCCESS) {
-		while (fru_offset < MAX_EEPROM_SZ)
-		{
-			// copy the start offset to the write buffer
-			memset(write_buffer, 0, sizeof(uint16_t));
-			memcpy(write_buffer, &fru_offset, sizeof(uint16_t));
+	if ((response = eeprom_read(&eeprom, 0, sizeof(FRU_HEADER), (uint8_t *)&header)) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "read_fields() common header read failed.");
+		goto end;
+	}
 
-			if ((fru_offset + MAX_PAYLOAD_LEN) < MAX_EEPROM_SZ)
-				read_length = MAX_PAYLOAD_LEN;
-			else
-			{
-				read_length = (MAX_EEPROM_SZ - fru_offset);
-			}
+	fru_index_offsets(&header, &index);
+	print_area_status(&index);
 
-			if (read_length > 0)
-				if (response = (*i2c_write_read)(handle, slave_addr, (uint8_t)sizeof(uint16_t), write_buffer, read_length, &buffer[buf_idx]) != SUCCESS)
-				{
-					log_fnc_err(UNKNOWN_ERROR, "read_raw_from_eeprom() i2c_write_read failed.");
-					break;
-				}
+	if (board && index.area[FRU_AREA_BOARD].status == FRU_AREA_ABSENT) {
+		log_out("no board area\n");
+	}
+	else if (board) {
+		if (wanted[FIELD_BOARD_MFGTIME]) {
+			if ((response = eeprom_read(&eeprom, index.area[FRU_AREA_BOARD].offset + sizeof(AREA_HEADER),
+				FRU_MFG_TIME_LEN, mfg_time)) != SUCCESS)
+				goto end;
+			log_out("%s: %s\n", fru_file_tag(FIELD_BOARD_MFGTIME), array_to_time(mfg_time));
+		}
 
-				fru_offset += read_length;
-				buf_idx += read_length;
+		if ((rc = read_area_fields(&eeprom, index.area[FRU_AREA_BOARD].offset, FRU_MFG_TIME_LEN,
+			FIELD_BOARD_MFGNAME, FIELD_BOARD_BUILD, wanted)) != SUCCESS) {
+			log_out("board area unreadable\n");
+			response = rc;
 		}
 	}
-	log_out("\n");
 
-	close_i2c_channel(handle);
+	if (product && index.area[FRU_AREA_PRODUCT].status == FRU_AREA_ABSENT) {
+		log_out("no product area\n");
+	}
+	else if (product && (rc = read_area_fields(&eeprom, index.area[FRU_AREA_PRODUCT].offset, 0,
+		FIELD_PRODUCT_MFGR, FIELD_PRODUCT_BUILD, wanted)) != SUCCESS) {
+		log_out("product area unreadable\n");
+		if (response == SUCCESS)
+			response = rc;
+	}
 
-	free(buffer);
+	log_out("selective read: %u bytes in %u reads\n", eeprom.bytes, eeprom.reads);
 
-	print_msg("eeprom read", &response);
+end:
+	close_i2c_channel(eeprom.handle);
 
 	return response;
 }
 
-/* reads raw fru data from eeprom */
-static int read_from_eeprom(uint8_t channel, uint8_t slave_addr) {
+/* reads the targets of one i2c bus in order */
+static void *bus_worker(void *arg)
+{
+	FRU_BUS_WORKER *worker = (FRU_BUS_WORKER *)arg;
+	FRU_TARGET *target;
+	uint8_t i;
+
+	for (i = 0; i < worker->count; i++) {
+		target = worker->targets[i];
+		target->response = fetch_from_eeprom(target->channel, target->slave_addr, worker->use_cache,
+			target->buffer, &target->length, &target->cache);
+	}
 
-	print_msg("reading from eeprom", NULL);
+	return NULL;
+}
 
-	uint8_t *buffer;
-	buffer = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
+/*
+parses a target list of the form channel:address[,channel:address...],
+both in hex.  returns the target count or FAILURE.
+*/
+static int parse_targets(char *list, FRU_TARGET *targets, uint8_t max_targets)
+{
+	char *save = NULL;
+	char *entry;
+	char *end;
+	int count = 0;
 
-	FRU_HEADER header;
-	memset(&header, 0, sizeof(FRU_HEADER));
+	for (entry = strtok_r(list, ",", &save); entry != NULL; entry = strtok_r(NULL, ",", &save)) {
 
-	uint16_t fru_offset = 0;
-	uint16_t buf_idx = 0;
-	uint8_t  write_buffer[sizeof(uint16_t)];
+		if (count >= max_targets) {
+			log_fnc_err(UNKNOWN_ERROR, "more than %d targets", max_targets);
+			return FAILURE;
+		}
 
-	int response = 0;
-	uint16_t length = 0;
-	// copy the start offset to the write buffer
-	memcpy(write_buffer, &fru_offset, sizeof(uint16_t));
+		memset(&targets[count], 0, sizeof(FRU_TARGET));
 
-	int32_t handle = 0;
-	// open i2c bus
-	if ((response = open_i2c_channel(channel, &handle)) != SUCCESS)
-		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
-
-	if (response == SUCCESS) {
+		targets[count].channel = (uint8_t)strtol(entry, &end, 16);
+		if (*end != ':') {
+			log_fnc_err(UNKNOWN_ERROR, "invalid target: %s", entry);
+			return FAILURE;
+		}
 
-		// i2c read fru header
-		if ((response = (*i2c_write_read)(handle, slave_addr, sizeof(uint16_t), write_buffer, sizeof(FRU_HEADER), &buffer[buf_idx])) == SUCCESS)
-		{
-			memcpy(&header, &buffer[buf_idx], sizeof(FRU_HEADER));
-			buf_idx += sizeof(FRU_HEADER);
+		targets[count].slave_addr = (uint8_t)strtol(end + 1, &end, 16);
+		if (*end != 0) {
+			log_fnc_err(UNKNOWN_ERROR, "invalid target: %s", entry);
+			return FAILURE;
+		}
 
-			if (header.board != 0)
-			{
-				// update the offset
-				fru_offset = (header.board * 8);
+		count++;
+	}
 
-				// copy the start offset to the write buffer
-				memset(&write_buffer, 0, sizeof(uint16_t));
-				memcpy(write_buffer, &fru_offset, sizeof(uint16_t));
+	return count;
+}
 
-				if (fru_offset > MAX_EEPROM_SZ)
-				{
-					log_fnc_err(UNKNOWN_ERROR, "board offset (%d) exceeded %d\n", fru_offset, MAX_EEPROM_SZ);
-				}
-				else
-				{
-					if (response = read_fru_area(handle, slave_addr, &fru_offset, &buf_idx, &length, buffer) != SUCCESS)
-						log_fnc_err(UNKNOWN_ERROR, "fru area board read_fru_area() i2c_write_read failed.");
-				}
-			}
+/* fetches every target with one worker per i2c bus */
+static void fetch_targets(FRU_TARGET *targets, int target_count, uint8_t use_cache)
+{
+	FRU_BUS_WORKER workers[MAX_TARGETS];
+	uint8_t worker_count = 0;
+	int i, w;
 
-			if (response == SUCCESS && header.product != 0)
-			{
-				// update the offset
-				fru_offset = (header.product * 8);
+	memset(workers, 0, sizeof(workers));
 
-				if (buf_idx > fru_offset)
-					buf_idx = fru_offset;
+	/* group targets by bus */
+	for (i = 0; i < target_count; i++) {
+		for (w = 0; w < worker_count; w++)
+			if (workers[w].channel == targets[i].channel)
+				break;
 
-				// copy the start offset to the write buffer
-				memset(&write_buffer, 0, sizeof(uint16_t));
-				memcpy(write_buffer, &fru_offset, sizeof(uint16_t));
+		if (w == worker_count) {
+			workers[w].channel = targets[i].channel;
+			workers[w].use_cache = use_cache;
+			worker_count++;
+		}
 
-				if (fru_offset > MAX_EEPROM_SZ)
-				{
-					log_fnc_err(UNKNOWN_ERROR, "product offset (%d) exceeded %d\n", fru_offset, MAX_EEPROM_SZ);
-				}
-				else
-				{
-					if ((response = read_fru_area(handle, slave_addr, &fru_offset, &buf_idx, &length, buffer)) != SUCCESS)
-					{
-						log_fnc_err(UNKNOWN_ERROR, "fru area product read_fru_area() i2c_write_read failed.");
-					}
-				}
-			}
+		workers[w].targets[workers[w].count++] = &targets[i];
+	}
 
-			if (response == SUCCESS)
-				response = read_fru_from_buffer(buffer, length);
+	for (w = 0; w < worker_count; w++) {
+		if (pthread_create(&workers[w].thread, NULL, bus_worker, &workers[w]) != SUCCESS) {
+			log_fnc_err(UNKNOWN_ERROR, "unable to start worker for bus %d", workers[w].channel);
+			/* read this bus inline */
+			bus_worker(&workers[w]);
+			workers[w].count = 0;
 		}
 	}
 
-	close_i2c_channel(handle);
-
-	free(buffer);
-
-	print_msg("eeprom read", &response);
-
-	return response;
+	for (w = 0; w < worker_count; w++)
+		if (workers[w].count > 0)
+			pthread_join(workers[w].thread, NULL);
 }
 
-/* writes a buffer to eeprom */
-static int write_to_eeprom(uint8_t channel, uint8_t slave_addr, uint16_t fru_offset, uint16_t write_length, uint8_t* buffer)
+/*
+reads a list of targets, buses concurrently and targets on the same
+bus in turn, then reports them in target order.  text goes through
+log_out, json and bin are built in memory and written at once.
+*/
+static int read_targets(FRU_TARGET *targets, int target_count, uint8_t use_cache, uint8_t output)
 {
-	int32_t response = SUCCESS;
-	uint8_t chunksize = 0;
-	uint8_t write_buf[sizeof(uint16_t)];
-	uint16_t write_idx = 0;
+	FRU_REPORT report;
+	int response = SUCCESS;
+	int report_rc = SUCCESS;
+	int i;
 
-	if (write_length > MAX_EEPROM_SZ){
-		log_fnc_err(UNKNOWN_ERROR, "fru data length cannot exceed maximum write length: %d.", MAX_EEPROM_SZ);
-		return FAILURE;
-	}
+	fetch_targets(targets, target_count, use_cache);
 
-	int32_t handle = 0;
-	// open i2c bus
-	if (open_i2c_channel(channel, &handle) != SUCCESS) {
-		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
-		return FAILURE;
-	}
+	if (output != FRU_OUTPUT_TEXT) {
+		if (report_init(&report, output) != SUCCESS) {
+			report_free(&report);
+			return FAILURE;
+		}
 
-	while (write_idx < write_length)
-	{
-		log_out(". ");
-		if ((write_idx + MAX_PAYLOAD_LEN) < write_length)
-			chunksize = MAX_PAYLOAD_LEN;
-		else
-			chunksize = write_length - write_idx;
+		/* failed targets are reported with their status */
+		for (i = 0; i < target_count && report_rc == SUCCESS; i++) {
+			report_rc = report_target(&report, &targets[i]);
+			if (targets[i].response != SUCCESS)
+				response = targets[i].response;
+		}
 
-		// copy the start offset to the write buffer
-		memset(write_buf, 0, sizeof(uint16_t));
-		memcpy(write_buf, &fru_offset, sizeof(uint16_t));
+		if (report_rc == SUCCESS)
+			report_rc = report_finish(&report);
 
-		if (chunksize > 0)
-			if (response = (*i2c_write)(handle, slave_addr, sizeof(uint16_t), write_buf, chunksize, &buffer[write_idx]) != SUCCESS)
-				goto end;
+		if (report_rc == SUCCESS)
+			report_rc = report_flush(&report, STDOUT_FILENO);
 
-		write_idx += chunksize;
-		fru_offset += chunksize;
+		if (report_rc != SUCCESS)
+			response = FAILURE;
+
+		report_free(&report);
+
+		return response;
 	}
-	log_out("\n");
 
-	end:
+	log_out("fru inventory: %d targets\n", target_count);
 
-	close_i2c_channel(handle);
+	for (i = 0; i < target_count; i++) {
+		print_msg("reading from eeprom", NULL);
+		log_out("i2c target: %d %x\n", targets[i].channel, targets[i].slave_addr);
+
+		if (targets[i].response == SUCCESS) {
+			print_cache(targets[i].cache);
+			targets[i].response = read_fru_from_buffer(targets[i].buffer, targets[i].length);
+		}
+
+		print_msg("eeprom read", (uint32_t *)&targets[i].response);
+
+		if (targets[i].response != SUCCESS)
+			response = targets[i].response;
+	}
 
 	return response;
 }
 
 /* opens input file and coordinates the write to eeprom */
-static int read_file_write_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t* filename)
+static int read_file_write_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t* filename, uint8_t diff_write,
+	uint8_t verify, uint8_t force)
 {
 	int rc;
 	if (filename != NULL) {
@@ -807,7 +514,8 @@ static int read_file_write_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t*
 			return FAILURE;
 		}
 
-		rc = read_fru_from_file(channel, slave_addr, input_file);
+		rc = read_fru_from_file(channel, slave_addr, input_file, diff_write, verify, force);
+		print_write_stats();
 
 		if (input_file != NULL)
 			fclose(input_file);
@@ -822,21 +530,22 @@ static int read_file_write_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t*
 
 int main(int argc, char **argv)
 {
-	if (argc <= 3){
+	/* the offline -b and -i modes take a single option */
+	if (argc <= 2){
 		usage();
 		return 1;
 	}
 
-#ifdef DEBUG
-	print_msg("warning debug mode", NULL);
-	/* assign fn ptr to debug func */
-	i2c_write_read = &i2c_write_read_dbg;
-	i2c_write = &i2c_write_dbg;
-	debug_buffer = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
-#else
 	/* assign fn ptr to prod func */
 	i2c_write_read = &i2c_write_read_prod;
 	i2c_write = &i2c_write_prod;
+	i2c_read_segments = &i2c_read_segments_prod;
+
+#ifdef DEBUG
+	print_msg("warning debug mode", NULL);
+	/* debug builds run against the simulated eeprom */
+	if (i2c_sim_configure("default") != SUCCESS)
+		return 1;
 #endif // DEBUG
 
 	int response = 0;
@@ -845,6 +554,23 @@ int main(int argc, char **argv)
 	uint8_t operation = 0;
 	uint8_t *filename = NULL;
 	uint8_t raw_read = 0;
+	char *field_list = NULL;
+	char *raw_path = NULL;
+	uint16_t mr_type = FRU_MR_NONE;
+	uint8_t use_cache = 1;
+	uint8_t diff_write = 0;
+	uint8_t verify = 0;
+	uint8_t force = 0;
+	char *target_list = NULL;
+	char *manifest = NULL;
+	char *scan_dir = NULL;
+	char *directory = ".";
+	uint32_t threads = 0;
+	int output = FRU_OUTPUT_TEXT;
+	int target_count = 0;
+	FRU_TARGET *targets = NULL;
+	long page_size;
+	char *end;
 
 	int i;
 		for (i = 0; i < argc; i++){
@@ -861,6 +587,88 @@ int main(int argc, char **argv)
 				if (argc > (i + 1)) {
 					if (strcmp(argv[i + 1], "raw") == SUCCESS)
 						raw_read = 1;
+
+					if (strncmp(argv[i + 1], "field=", 6) == SUCCESS)
+						field_list = argv[i + 1] + 6;
+
+					/* an image file may follow, stdout otherwise */
+					if (raw_read && argc > (i + 2) && argv[i + 2][0] != '-')
+						raw_path = argv[i + 2];
+				}
+			}
+
+			if (strcmp(argv[i], "-n") == SUCCESS)
+				use_cache = 0;
+
+			if (strcmp(argv[i], "-M") == SUCCESS && argc > (i + 1)) {
+				if (strcmp(argv[i + 1], "all") == SUCCESS)
+					mr_type = FRU_MR_ALL;
+				else
+					mr_type = (uint8_t)strtol(argv[i + 1], NULL, 16);
+			}
+
+			if (strcmp(argv[i], "-d") == SUCCESS)
+				diff_write = 1;
+
+			if (strcmp(argv[i], "-v") == SUCCESS)
+				verify = 1;
+
+			if (strcmp(argv[i], "-f") == SUCCESS)
+				force = 1;
+
+			if (strcmp(argv[i], "-p") == SUCCESS && argc > (i + 1)) {
+				page_size = strtol(argv[i + 1], &end, 10);
+
+				/* page sizes are a power of two, checked before narrowing */
+				if (*end != '\0' || page_size < I2C_MIN_PAGE_SIZE || page_size > I2C_MAX_PAGE_SIZE ||
+					(page_size & (page_size - 1)) != 0) {
+					usage();
+					response = UNKNOWN_ERROR;
+					goto main_end;
+				}
+
+				eeprom_page_size = (uint16_t)page_size;
+			}
+
+			if (strcmp(argv[i], "-S") == SUCCESS && argc > (i + 1)) {
+				if (i2c_sim_configure(argv[i + 1]) != SUCCESS) {
+					usage();
+					response = UNKNOWN_ERROR;
+					goto main_end;
+				}
+			}
+
+			if (strcmp(argv[i], "-a") == SUCCESS && argc > (i + 1))
+				i2c_set_ack_poll(strtoul(argv[i + 1], NULL, 10));
+
+			if (strcmp(argv[i], "-R") == SUCCESS && argc > (i + 1)) {
+				if (i2c_retry_configure(argv[i + 1]) != SUCCESS) {
+					usage();
+					response = UNKNOWN_ERROR;
+					goto main_end;
+				}
+			}
+
+			if (strcmp(argv[i], "-m") == SUCCESS && argc > (i + 1))
+				target_list = argv[i + 1];
+
+			if (strcmp(argv[i], "-b") == SUCCESS && argc > (i + 1))
+				manifest = argv[i + 1];
+
+			if (strcmp(argv[i], "-i") == SUCCESS && argc > (i + 1))
+				scan_dir = argv[i + 1];
+
+			if (strcmp(argv[i], "-O") == SUCCESS && argc > (i + 1))
+				directory = argv[i + 1];
+
+			if (strcmp(argv[i], "-j") == SUCCESS && argc > (i + 1))
+				threads = strtoul(argv[i + 1], NULL, 10);
+
+			if (strcmp(argv[i], "-o") == SUCCESS && argc > (i + 1)) {
+				if ((output = report_output(argv[i + 1])) < SUCCESS) {
+					usage();
+					response = UNKNOWN_ERROR;
+					goto main_end;
 				}
 			}
 
@@ -878,29 +686,78 @@ int main(int argc, char **argv)
 			}
 		}
 
-		if (validate_fru_address != SUCCESS)
+		if (scan_dir != NULL)
+		{
+			/* offline, checks saved images and never opens a bus */
+			response = fru_scan_images(scan_dir, threads);
+		}
+		else if (manifest != NULL)
+		{
+			/* offline, builds image files and never opens a bus */
+			response = fru_manifest_build(manifest, directory, threads);
+		}
+		else if (target_list != NULL || (output != FRU_OUTPUT_TEXT && operation == 0))
+		{
+			if (operation == 0 && raw_read == 0) {
+				targets = calloc(MAX_TARGETS, sizeof(FRU_TARGET));
+
+				if (targets == NULL) {
+					log_fnc_err(UNKNOWN_ERROR, "unable to allocate target list");
+					response = UNKNOWN_ERROR;
+				}
+				else if (target_list != NULL) {
+					target_count = parse_targets(target_list, targets, MAX_TARGETS);
+				}
+				else {
+					targets[0].channel = channel;
+					targets[0].slave_addr = slave_addr;
+					target_count = 1;
+				}
+
+				/* read every target, one worker per bus */
+				if (target_count > 0)
+					response = read_targets(targets, target_count, use_cache, (uint8_t)output);
+				else
+					response = UNKNOWN_ERROR;
+
+				free(targets);
+			}
+			else {
+				log_fnc_err(UNKNOWN_ERROR, "-m and -o only support fru read.");
+				response = UNKNOWN_ERROR;
+			}
+		}
+		else if (validate_fru_address != SUCCESS)
 		{
 
-			log_out("i2c target: %d %x\n", channel, slave_addr);
+			/* a raw image on stdout is not mixed with text */
+			if (!(operation == 0 && raw_read && raw_path == NULL))
+				log_out("i2c target: %d %x\n", channel, slave_addr);
 
 			if (operation == 0) {
 
-				if (raw_read == 0) {
+				if (field_list != NULL) {
+					response = read_fields(channel, slave_addr, field_list);
+				}
+				else if (mr_type != FRU_MR_NONE) {
+					response = read_multirecords(channel, slave_addr, mr_type);
+				}
+				else if (raw_read == 0) {
 					/* read from the target eeprom */
-					response = read_from_eeprom(channel, slave_addr);
+					response = read_from_eeprom(channel, slave_addr, use_cache);
 				}
 				else
 				{
-					response = read_raw_from_eeprom(channel, slave_addr);
+					response = read_raw_from_eeprom(channel, slave_addr, raw_path);
 				}
 			}
 			else{
 				if (filename != NULL) {
 					/* read input file and write it to the eeprom */
-					response = read_file_write_eeprom(channel, slave_addr, filename);
+					response = read_file_write_eeprom(channel, slave_addr, filename, diff_write, verify, force);
 #ifdef DEBUG
 					/* in debug mode do read back*/
-					response = read_from_eeprom(channel, slave_addr);
+					response = read_from_eeprom(channel, slave_addr, use_cache);
 #endif // DEBUG
 				}
 				else {
@@ -918,7 +775,6 @@ int main(int argc, char **argv)
 	main_end:
 
 #ifdef DEBUG
-		free(debug_buffer);
 		print_msg("warning debug mode - end", NULL);
 #endif // DEBUG
 
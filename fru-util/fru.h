@@ -5,17 +5,15 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#ifndef __fru_h
+#define __fru_h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include "i2clib.h"
-
-/* fru definitions */
-#define FRU_LANG			0x00
-#define FRU_VERSION			0x01
-#define FRU_LENGTH_MASK		0x3F
-#define FRU_AREA_STOP		0xC1
+#include "ocsfru.h"
 
 #define I2C_BUS_0			0x04
 #define I2C_BUS_1			0x01
@@ -31,66 +29,66 @@
 #define MAX_NAME_LEN		18
 #define MAX_LENGTH			62
 #define MAX_EEPROM_SZ		1280
+#define MAX_SEGMENTS		((MAX_EEPROM_SZ / MAX_PAYLOAD_LEN) + 2)
+#define MAX_WRITE_CHUNKS	((MAX_EEPROM_SZ / I2C_MIN_PAGE_SIZE) + 2)
+#define MAX_TARGETS			16
+#define MAX_VERIFY_ROUNDS	3		/* read back and rewrite passes of -v */
 
+/* -M selection, other values are a multirecord type */
+#define FRU_MR_NONE			0xFFFF
+#define FRU_MR_ALL			0x0100
 
+#include <pthread.h>
 
-#define PACK( __Declaration__ ) __Declaration__ __attribute__((__packed__))
-/*#define PACK( __Declaration__ ) __pragma( pack(push, 1) ) __Declaration__ __pragma( pack(pop) )*/
-
-/* fru eeprom header format */
-PACK(typedef struct fru_header
+/* FRU_FIELDS index of each fru file tag */
+enum fru_field_id
 {
-	uint8_t        commonheader;
-	uint8_t        areaoffset;
-	uint8_t        chassis;
-	uint8_t        board;
-	uint8_t        product;
-	uint8_t        multirecord;
-	uint8_t        pad;
-	uint8_t		   checksum;
-}) FRU_HEADER;
+	FIELD_BOARD_MFGTIME = 0,
+	FIELD_BOARD_MFGNAME,
+	FIELD_BOARD_PRODUCT,
+	FIELD_BOARD_SERIAL,
+	FIELD_BOARD_PARTNUMBER,
+	FIELD_BOARD_FRUID,
+	FIELD_BOARD_ADDRESS1,
+	FIELD_BOARD_ADDRESS2,
+	FIELD_BOARD_VERSION,
+	FIELD_BOARD_BUILD,
+	FIELD_PRODUCT_MFGR,
+	FIELD_PRODUCT_PRODUCT,
+	FIELD_PRODUCT_MODEL,
+	FIELD_PRODUCT_SERIAL,
+	FIELD_PRODUCT_ASSETTAG,
+	FIELD_PRODUCT_FRUID,
+	FIELD_PRODUCT_SUBPROD,
+	FIELD_PRODUCT_BUILD,
+	/* decoded only, there is no input file tag */
+	FIELD_CHASSIS_PART = MAX_RECORDS,
+	FIELD_CHASSIS_SERIAL,
+	/* fields after the known ones of an area */
+	FIELD_CHASSIS_CUSTOM,
+	FIELD_BOARD_CUSTOM,
+	FIELD_PRODUCT_CUSTOM
+};
 
-/* fru area common header */
-PACK(typedef struct area_header
+/* target of a multi-target read */
+typedef struct fru_target
 {
-	uint8_t        version : 4;
-	uint8_t        length;
-	uint8_t        languagecode;
-}) AREA_HEADER;
+	uint8_t			channel;
+	uint8_t			slave_addr;
+	uint8_t			cache;
+	int				response;
+	uint16_t		length;
+	uint8_t			buffer[MAX_EEPROM_SZ];
+} FRU_TARGET;
 
-/* fru area field */
-PACK(typedef struct fru_field
+/* targets sharing one i2c bus, read in order by one worker */
+typedef struct fru_bus_worker
 {
-	uint8_t			*length;
-	uint8_t         *data;
-}) AREA_FIELD;
+	pthread_t		thread;
+	uint8_t			channel;
+	uint8_t			use_cache;
+	uint8_t			count;
+	FRU_TARGET		*targets[MAX_TARGETS];
+} FRU_BUS_WORKER;
 
-/* fru board info area */
-PACK(typedef struct fru_board_info
-{
-	AREA_HEADER 	header;
-	uint8_t			mfgdatetime[3];
-	AREA_FIELD      manufacture;
-	AREA_FIELD      name;
-	AREA_FIELD		serial;
-	AREA_FIELD		part;
-	AREA_FIELD		fruid;
-	AREA_FIELD		address1;
-	AREA_FIELD		address2;
-	AREA_FIELD		boardver;
-	AREA_FIELD		build;
-}) FRU_BOARD_INFO;
-
-/* fru product info area */
-PACK(typedef struct fru_product_info
-{
-	AREA_HEADER		header;
-	AREA_FIELD      manufacture;
-	AREA_FIELD      productname;
-	AREA_FIELD		productversion;
-	AREA_FIELD		serial;
-	AREA_FIELD		assettag;
-	AREA_FIELD		fruid;
-	AREA_FIELD		subproduct;
-	AREA_FIELD		build;
-}) FRU_PRODUCT_INFO;
+#endif //__fru_h
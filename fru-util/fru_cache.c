@@ -0,0 +1,161 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fru_cache.h"
+#include "ocslog.h"
+
+/* the simulator keeps its entries apart from the devices' */
+static const char *cache_dir(void)
+{
+	return i2c_sim_enabled() ? FRU_CACHE_SIM_DIR : FRU_CACHE_DIR;
+}
+
+/* builds the cache file name for a target */
+static void cache_file_name(uint8_t channel, uint8_t slave_addr, char *filename, size_t size)
+{
+	snprintf(filename, size, i2c_sim_enabled() ? FRU_CACHE_SIM_FILE : FRU_CACHE_FILE, channel, slave_addr);
+}
+
+/* adds an area's length byte and check sum byte to the fingerprint */
+static int add_area_probes(FRU_CACHE *cache, uint8_t *image, FRU_AREA *area)
+{
+	uint16_t end = 0;
+
+	if (area->status == FRU_AREA_ABSENT)
+		return SUCCESS;
+
+	/* areas left present were skipped by the read, not measured */
+	if (area->status == FRU_AREA_BAD || area->status == FRU_AREA_PRESENT ||
+		cache->probe_count + 2 > FRU_CACHE_PROBES)
+		return FAILURE;
+
+	/* check sum is the last byte of the area */
+	end = area->offset + area->length - 1;
+
+	cache->probe_offset[cache->probe_count] = area->offset + 1;
+	cache->probe_value[cache->probe_count++] = image[area->offset + 1];
+
+	cache->probe_offset[cache->probe_count] = end;
+	cache->probe_value[cache->probe_count++] = image[end];
+
+	return SUCCESS;
+}
+
+/*
+populates a cache entry from an eeprom image read from the device.
+*/
+int fru_cache_fingerprint(FRU_CACHE *cache, uint8_t *image, uint16_t length)
+{
+	FRU_INDEX index;
+
+	if (length < sizeof(FRU_HEADER) || length > MAX_EEPROM_SZ)
+		return FAILURE;
+
+	if (fru_index_build(image, length, &index) != SUCCESS)
+		return FAILURE;
+
+	memset(cache, 0, sizeof(FRU_CACHE));
+
+	cache->magic = FRU_CACHE_MAGIC;
+	cache->version = FRU_CACHE_VERSION;
+	cache->length = length;
+	memcpy(cache->image, image, length);
+
+	if (add_area_probes(cache, image, &index.area[FRU_AREA_CHASSIS]) != SUCCESS ||
+		add_area_probes(cache, image, &index.area[FRU_AREA_BOARD]) != SUCCESS ||
+		add_area_probes(cache, image, &index.area[FRU_AREA_PRODUCT]) != SUCCESS)
+		return FAILURE;
+
+	return SUCCESS;
+}
+
+/*
+loads the cache entry for a target, fails when there is no
+usable entry.
+*/
+int fru_cache_load(uint8_t channel, uint8_t slave_addr, FRU_CACHE *cache)
+{
+	char filename[64];
+	ssize_t bytes = 0;
+	int fd;
+
+	cache_file_name(channel, slave_addr, filename, sizeof(filename));
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return FAILURE;
+
+	bytes = read(fd, cache, sizeof(FRU_CACHE));
+	close(fd);
+
+	if (bytes != sizeof(FRU_CACHE) || cache->magic != FRU_CACHE_MAGIC ||
+		cache->version != FRU_CACHE_VERSION || cache->length > MAX_EEPROM_SZ ||
+		cache->length < sizeof(FRU_HEADER) || cache->probe_count > FRU_CACHE_PROBES) {
+		log_info("fru cache: discarding invalid entry %s", filename);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+stores the cache entry for a target.  the entry is written to a
+temporary file and renamed so readers never see a partial entry.
+*/
+int fru_cache_store(uint8_t channel, uint8_t slave_addr, FRU_CACHE *cache)
+{
+	char filename[64];
+	char tmpname[72];
+	ssize_t bytes = 0;
+	int fd;
+
+	if (mkdir(cache_dir(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) != SUCCESS && errno != EEXIST) {
+		log_info("fru cache: cannot create %s (%s)", cache_dir(), strerror(errno));
+		return FAILURE;
+	}
+
+	cache_file_name(channel, slave_addr, filename, sizeof(filename));
+	snprintf(tmpname, sizeof(tmpname), "%s.%d", filename, getpid());
+
+	fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		log_info("fru cache: cannot create %s (%s)", tmpname, strerror(errno));
+		return FAILURE;
+	}
+
+	bytes = write(fd, cache, sizeof(FRU_CACHE));
+	close(fd);
+
+	if (bytes != sizeof(FRU_CACHE) || rename(tmpname, filename) != SUCCESS) {
+		log_info("fru cache: cannot store %s", filename);
+		unlink(tmpname);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+drops the cache entry for a target.  called before every write.
+*/
+int fru_cache_invalidate(uint8_t channel, uint8_t slave_addr)
+{
+	char filename[64];
+
+	cache_file_name(channel, slave_addr, filename, sizeof(filename));
+
+	if (unlink(filename) != SUCCESS && errno != ENOENT) {
+		log_fnc_err(errno, "fru cache: cannot remove %s", filename);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
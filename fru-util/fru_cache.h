@@ -0,0 +1,50 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __fru_cache_h
+#define __fru_cache_h
+
+#include "fru.h"
+
+/* cache file location */
+#define FRU_CACHE_DIR		"/run/ocs-fru"
+#define FRU_CACHE_FILE		FRU_CACHE_DIR "/fru-%d-%02x.cache"
+#define FRU_CACHE_SIM_DIR	"/run/ocs-fru-sim"	/* simulated devices, never a real entry */
+#define FRU_CACHE_SIM_FILE	FRU_CACHE_SIM_DIR "/fru-%d-%02x.cache"
+#define FRU_CACHE_MAGIC		0x46525543	/* "FRUC" */
+#define FRU_CACHE_VERSION	2	/* 2 adds the chassis area */
+
+/* cache outcome of a read */
+#define FRU_CACHE_OFF		0
+#define FRU_CACHE_MISS		1
+#define FRU_CACHE_HIT		2
+
+/* area length and check sum byte for each cached area */
+#define FRU_CACHE_PROBES	8
+
+/*
+cached eeprom image, keyed by channel and slave address.  the common
+header and the probe bytes form the fingerprint checked against the
+device before the image is trusted.
+*/
+PACK(typedef struct fru_cache
+{
+	uint32_t		magic;
+	uint8_t			version;
+	uint8_t			probe_count;
+	uint16_t		length;
+	uint16_t		probe_offset[FRU_CACHE_PROBES];
+	uint8_t			probe_value[FRU_CACHE_PROBES];
+	uint8_t			image[MAX_EEPROM_SZ];
+}) FRU_CACHE;
+
+int fru_cache_fingerprint(FRU_CACHE *cache, uint8_t *image, uint16_t length);
+int fru_cache_load(uint8_t channel, uint8_t slave_addr, FRU_CACHE *cache);
+int fru_cache_store(uint8_t channel, uint8_t slave_addr, FRU_CACHE *cache);
+int fru_cache_invalidate(uint8_t channel, uint8_t slave_addr);
+
+#endif //__fru_cache_h
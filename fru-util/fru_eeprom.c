@@ -0,0 +1,894 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fru_sup.h"
+#include "fru_cache.h"
+#include "fru_file.h"
+#include "fru_eeprom.h"
+#include "ocslog.h"
+
+/* eeprom write page size in bytes, set with -p */
+uint16_t eeprom_page_size = MAX_PAGE_SIZE;
+
+
+/* function pointer for i2c write read */
+int(*i2c_write_read)(int32_t handle,
+	uint8_t slave_addr,
+	uint8_t write_length,
+	uint8_t* write_data,
+	uint8_t read_length,
+	uint8_t* buffer);
+
+/* function pointer for i2c write */
+int(*i2c_write)(int32_t handle,
+	uint8_t slave_addr,
+	uint8_t write_length,
+	uint8_t* write_data,
+	uint8_t data_length,
+	uint8_t* data);
+
+/* function pointer for i2c scatter/gather read */
+int(*i2c_read_segments)(int32_t handle,
+	uint8_t slave_addr,
+	uint16_t count,
+	I2C_SEGMENT* segments);
+
+
+/* prints a decoded fru field, fields after an early end marker are empty */
+static void print_field(const char *name, AREA_FIELD *field)
+{
+	char text[FRU_FIELD_TEXT_LEN];
+
+	fru_field_text(field, text, sizeof(text));
+	log_out("%s: %s \n", name, text);
+}
+
+/* prints the fields after the known ones of an area */
+static void print_custom(const char *area, AREA_FIELD *custom, uint8_t count)
+{
+	char name[MAX_NAME_LEN + 8];
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof(name), "%s custom%d", area, i + 1);
+		print_field(name, &custom[i]);
+	}
+}
+
+/* reports areas whose check sum or bounds are wrong */
+void print_area_status(FRU_INDEX *index)
+{
+	uint8_t area;
+
+	if (index->header_status == FRU_AREA_CHKSUM)
+		log_out("common header: check sum mismatch\n");
+
+	for (area = 0; area < FRU_AREA_COUNT; area++) {
+		if (index->area[area].status == FRU_AREA_CHKSUM)
+			log_out("%s area: check sum mismatch at offset %d\n", fru_area_name(area), index->area[area].offset);
+		else if (index->area[area].status == FRU_AREA_BAD)
+			log_out("%s area: malformed at offset %d\n", fru_area_name(area), index->area[area].offset);
+	}
+}
+
+/*
+	decodes fru data in buffer and prints the fields.
+*/
+int read_fru_from_buffer(uint8_t *buffer, uint16_t length)
+{
+	uint8_t * mfgtime;
+
+	FRU_INFO info;
+
+	if (fru_decode(buffer, length, &info) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "FRU buffer lenght does not support board and product area data");
+		return FAILURE;
+	}
+
+	print_area_status(&info.index);
+
+	if (info.has_chassis) {
+		log_out("chassis type: %d \n", info.chassis.type);
+		print_field("chassis part", &info.chassis.part);
+		print_field("chassis serial", &info.chassis.serial);
+		print_custom("chassis", info.chassis.custom, info.chassis.custom_count);
+	}
+
+	if (info.has_board) {
+		mfgtime = array_to_time(info.board.mfgdatetime);
+		log_out("board mfgdatetime: %s \n", mfgtime);
+
+		print_field("board manufacturer", &info.board.manufacture);
+		print_field("board name", &info.board.name);
+		print_field("board serial", &info.board.serial);
+		print_field("board part", &info.board.part);
+		print_field("board fruId", &info.board.fruid);
+
+		if (fru_field_length(&info.board.address1) > 0)
+			print_field("board address1", &info.board.address1);
+
+		if (fru_field_length(&info.board.address2) > 0)
+			print_field("board address2", &info.board.address2);
+
+		print_field("board version", &info.board.boardver);
+		print_field("board build", &info.board.build);
+		print_custom("board", info.board.custom, info.board.custom_count);
+	}
+
+	if (info.has_product) {
+		print_field("product manufacture", &info.product.manufacture);
+		print_field("product productname", &info.product.productname);
+		print_field("product productversion", &info.product.productversion);
+		print_field("product serial", &info.product.serial);
+		print_field("product assettag", &info.product.assettag);
+		print_field("product fruid", &info.product.fruid);
+		print_field("product subproduct", &info.product.subproduct);
+		print_field("product build", &info.product.build);
+		print_custom("product", info.product.custom, info.product.custom_count);
+	}
+
+	return SUCCESS;
+}
+
+/*
+	encodes fru text data from file into an eeprom image
+*/
+int encode_fru_file(FILE *input, uint8_t *fru_data, uint16_t *length)
+{
+	FRU_FILE file;
+
+	/* parse errors are printed line by line */
+	if (fru_file_load(input, &file) != SUCCESS)
+		return UNKNOWN_ERROR;
+
+	if (fru_file_encode(&file, fru_data, length) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "content to large for FRU designated EEPROM space");
+		return UNKNOWN_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/* write read from i2c device */
+int i2c_write_read_prod(int32_t handle, uint8_t slave_addr,
+	uint8_t write_length, uint8_t* write_data, uint8_t read_length, uint8_t* buffer)
+{
+	// switch msb->lsb
+	uint16_t offset = (uint16_t)(write_data[0]<<8|write_data[1]);
+	memcpy(write_data, &offset, sizeof(uint16_t));
+
+	if(i2c_block_read(handle, slave_addr, write_length, write_data, read_length, buffer)!= SUCCESS){
+		log_fnc_err(UNKNOWN_ERROR, "i2c read_after_write failed for eeprom: (%02x).\n", slave_addr);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/* write to i2c device */
+int i2c_write_prod(int32_t handle, uint8_t slave_addr,
+	uint8_t write_length, uint8_t *write_data, uint8_t data_length, uint8_t *buffer)
+{
+		uint16_t offset = (uint16_t)(write_data[0]<<8 | write_data[1]);
+		memcpy(write_data, &offset, sizeof(uint16_t));
+
+		if(i2c_block_write(handle, slave_addr, write_length, write_data, data_length, buffer) != SUCCESS)
+		{
+				log_fnc_err(UNKNOWN_ERROR, "i2c write failed for eeprom (%02x).\n", slave_addr);
+				return FAILURE;
+		}
+
+		return SUCCESS;
+}
+
+/* scatter/gather read from i2c device */
+int i2c_read_segments_prod(int32_t handle, uint8_t slave_addr,
+	uint16_t count, I2C_SEGMENT* segments)
+{
+	if (i2c_block_read_segments(handle, slave_addr, count, segments) != SUCCESS){
+		log_fnc_err(UNKNOWN_ERROR, "i2c segment read failed for eeprom: (%02x).\n", slave_addr);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+splits an eeprom range into read segments of at most MAX_PAYLOAD_LEN
+that never cross a page boundary. returns the segment count or
+FAILURE when the list is too short.
+*/
+int plan_read_segments(uint16_t fru_offset, uint16_t length, uint8_t *buffer,
+	I2C_SEGMENT *segments, uint16_t max_segments)
+{
+	uint16_t count = 0;
+	uint16_t read_length = 0;
+	uint16_t boundary = 0;
+
+	while (length > 0)
+	{
+		if (count >= max_segments)
+			return FAILURE;
+
+		read_length = length > MAX_PAYLOAD_LEN ? MAX_PAYLOAD_LEN : length;
+
+		/* get page boundary */
+		boundary = MAX_PAGE_SIZE - (fru_offset % MAX_PAGE_SIZE);
+
+		if (read_length > boundary)
+			read_length = boundary;
+
+		segments[count].offset = fru_offset;
+		segments[count].length = read_length;
+		segments[count].buffer = buffer;
+		count++;
+
+		fru_offset += read_length;
+		buffer += read_length;
+		length -= read_length;
+	}
+
+	return count;
+}
+
+/* supports fru read, by reading fru area from eeprom */
+static int read_fru_area(int32_t handle, uint8_t slave_addr, uint16_t *fru_offset,
+	uint16_t *buf_idx, int16_t *area_length, uint8_t *buffer)
+{
+	int response = SUCCESS;
+	int count = 0;
+	uint16_t length = 0;
+	uint8_t write_buffer[sizeof(uint16_t)];
+	I2C_SEGMENT segments[MAX_SEGMENTS];
+
+	AREA_HEADER area_header;
+	memset(&area_header, 0, sizeof(AREA_HEADER));
+
+	// copy the start offset to the write buffer
+	memset(&write_buffer, 0, sizeof(uint16_t));
+	memcpy(write_buffer, fru_offset, sizeof(uint16_t));
+
+	/* ensure fru header is withn the page, or read across page boundaries */
+	if (MAX_PAGE_SIZE - (*fru_offset % MAX_PAGE_SIZE) > sizeof(AREA_HEADER)) {
+		response = (*i2c_write_read)(handle, slave_addr, (uint8_t)sizeof(uint16_t), write_buffer, sizeof(AREA_HEADER), &buffer[*buf_idx]);
+	}
+	else{
+		uint16_t i = 0;
+		uint16_t tmp_idx = *buf_idx;
+		uint16_t offset = *fru_offset;
+
+		for (; i < sizeof(area_header); i++) {
+			if (response = (*i2c_write_read)(handle, slave_addr, (uint8_t)sizeof(uint16_t), write_buffer, sizeof(uint8_t), &buffer[tmp_idx]) != SUCCESS) {
+				log_fnc_err(UNKNOWN_ERROR, "area head read error (%d)", response);
+				return FAILURE;
+			}
+
+			offset++;
+			tmp_idx++;
+
+			memcpy(write_buffer, &offset, sizeof(uint16_t));
+		}
+
+	}
+
+	if (response == SUCCESS)
+	{
+		memcpy(&area_header, &buffer[*buf_idx], sizeof(AREA_HEADER));
+		*fru_offset += sizeof(AREA_HEADER);
+		*buf_idx += sizeof(AREA_HEADER);
+
+		*area_length += (area_header.length * 8);
+		if(*area_length > MAX_EEPROM_SZ/2)
+		{
+			log_fnc_err(UNKNOWN_ERROR, "area length (%d) exceeded %d\n", *area_length, MAX_EEPROM_SZ/2);
+			return FAILURE;
+		}
+
+		if (area_header.length != 0)
+		{
+			length = ((area_header.length * 8) - sizeof(AREA_HEADER));
+
+			if (*buf_idx + length > MAX_EEPROM_SZ)
+			{
+				log_fnc_err(UNKNOWN_ERROR, "area end (%d) exceeded %d\n", *buf_idx + length, MAX_EEPROM_SZ);
+				return FAILURE;
+			}
+
+			count = plan_read_segments(*fru_offset, length, &buffer[*buf_idx], segments, arr_size(segments));
+			if (count < SUCCESS)
+			{
+				log_fnc_err(UNKNOWN_ERROR, "area length (%d) needs too many read segments\n", length);
+				return FAILURE;
+			}
+
+			if ((*i2c_read_segments)(handle, slave_addr, (uint16_t)count, segments) != SUCCESS)
+			{
+				log_fnc_err(UNKNOWN_ERROR, "read_fru_area() i2c_read_segments failed.");
+				return FAILURE;
+			}
+
+			*fru_offset += length;
+			*buf_idx += length;
+		}
+	}
+
+	return response;
+}
+
+/* FRU_READ_FN over the device, only the requested bytes cross the bus */
+int eeprom_read(void *context, uint16_t offset, uint16_t length, uint8_t *buffer)
+{
+	EEPROM_READ_CTX *eeprom = (EEPROM_READ_CTX *)context;
+	I2C_SEGMENT segments[(FRU_MR_MAX_DATA / MAX_PAYLOAD_LEN) + 2];
+	int count;
+
+	count = plan_read_segments(offset, length, buffer, segments, arr_size(segments));
+	if (count < SUCCESS)
+		return FAILURE;
+
+	eeprom->reads++;
+	eeprom->bytes += length;
+
+	return (*i2c_read_segments)(eeprom->handle, eeprom->slave_addr, (uint16_t)count, segments);
+}
+
+/* prints a record, decoding the types with a fixed layout */
+static void print_multirecord(FRU_MR_RECORD *record, uint8_t *data)
+{
+	FRU_MR_PSU psu;
+	FRU_MR_OUTPUT output;
+	char hex[(FRU_MR_MAX_DATA * 3) + 1];
+	uint16_t i;
+
+	if (fru_mr_psu(record, data, &psu) == SUCCESS) {
+		log_out("  capacity: %d W, peak: %d VA, peak wattage: %d W, hold up: %d s\n",
+			psu.capacity, psu.peak_va, psu.peak_watts, psu.holdup_s);
+		log_out("  input: %d.%02d-%d.%02d V, %d.%02d-%d.%02d V, %d-%d Hz\n",
+			psu.input_low[0] / 100, psu.input_low[0] % 100, psu.input_high[0] / 100, psu.input_high[0] % 100,
+			psu.input_low[1] / 100, psu.input_low[1] % 100, psu.input_high[1] / 100, psu.input_high[1] % 100,
+			psu.freq_low, psu.freq_high);
+		log_out("  inrush: %d A for %d ms, dropout tolerance: %d ms, flags: 0x%02x\n",
+			psu.inrush_current, psu.inrush_ms, psu.dropout_ms, psu.flags);
+		return;
+	}
+
+	if (fru_mr_dc_output(record, data, &output) == SUCCESS) {
+		log_out("  output %d%s: nominal %d mV (%d/+%d mV), ripple %d mV, current %d-%d mA\n",
+			output.output, output.standby ? " standby" : "", output.nominal * 10,
+			output.deviation_low * 10, output.deviation_high * 10, output.ripple_mv,
+			output.current_min, output.current_max);
+		return;
+	}
+
+	for (i = 0; i < record->length; i++)
+		sprintf(&hex[i * 3], " %02x", data[i]);
+	hex[i * 3] = '\0';
+
+	log_out("  data:%s\n", hex);
+}
+
+/*
+lists the multirecord area one header at a time.  record data is read
+only for records of the requested type, or all of them for FRU_MR_ALL.
+*/
+int read_multirecords(uint8_t channel, uint8_t slave_addr, uint16_t type)
+{
+	EEPROM_READ_CTX eeprom;
+	FRU_HEADER header;
+	FRU_INDEX index;
+	FRU_MR_READER reader;
+	FRU_MR_RECORD record;
+	uint8_t data[FRU_MR_MAX_DATA];
+	uint16_t count = 0;
+	int response;
+	int rc;
+
+	memset(&eeprom, 0, sizeof(EEPROM_READ_CTX));
+	eeprom.slave_addr = slave_addr;
+
+	if ((response = open_i2c_channel(channel, &eeprom.handle)) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
+		return response;
+	}
+
+	if ((response = eeprom_read(&eeprom, 0, sizeof(FRU_HEADER), (uint8_t *)&header)) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "read_multirecords() common header read failed.");
+		goto end;
+	}
+
+	fru_index_offsets(&header, &index);
+
+	if (index.header_status != FRU_AREA_OK) {
+		log_fnc_err(UNKNOWN_ERROR, "common header check sum mismatch");
+		response = FAILURE;
+		goto end;
+	}
+
+	if (index.area[FRU_AREA_MULTIRECORD].status == FRU_AREA_ABSENT) {
+		log_out("no multirecord area\n");
+		goto end;
+	}
+
+	fru_mr_open(&reader, index.area[FRU_AREA_MULTIRECORD].offset, MAX_EEPROM_SZ, eeprom_read, &eeprom);
+
+	while ((rc = fru_mr_next(&reader, &record)) == SUCCESS) {
+		log_out("record %d: type 0x%02x (%s), format %d, length %d, offset %d\n", count++,
+			record.type, fru_mr_type_name(record.type), record.format, record.length, record.offset);
+
+		if (type != FRU_MR_ALL && type != record.type)
+			continue;
+
+		if (fru_mr_data(&reader, &record, data) != SUCCESS) {
+			log_out("  %s\n", record.status == FRU_AREA_CHKSUM ? "data check sum mismatch" : "data read failed");
+			response = FAILURE;
+			continue;
+		}
+
+		print_multirecord(&record, data);
+	}
+
+	if (rc != FRU_MR_DONE) {
+		log_out("record %d: %s at offset %d\n", count, record.status == FRU_AREA_CHKSUM ?
+			"header check sum mismatch" : "unreadable header", record.offset);
+		response = FAILURE;
+	}
+
+end:
+	close_i2c_channel(eeprom.handle);
+
+	print_msg("multirecord read", &response);
+
+	return response;
+}
+
+/* areas read from the device, the ones with a length byte */
+static const uint8_t READ_AREAS[] = { FRU_AREA_CHASSIS, FRU_AREA_BOARD, FRU_AREA_PRODUCT };
+
+/*
+reads the chassis, board and product areas named by the common
+header.  areas are kept at their eeprom offset and buf_idx returns
+the end of the last one.
+*/
+static int read_fru_areas(int32_t handle, uint8_t slave_addr, FRU_HEADER *header,
+	uint8_t *buffer, uint16_t *buf_idx)
+{
+	FRU_INDEX index;
+	FRU_AREA *area;
+	int response = SUCCESS;
+	int16_t length = 0;
+	uint16_t fru_offset = 0;
+	uint16_t image_end = *buf_idx;
+	uint8_t i;
+
+	fru_index_offsets(header, &index);
+
+	for (i = 0; i < arr_size(READ_AREAS) && response == SUCCESS; i++)
+	{
+		area = &index.area[READ_AREAS[i]];
+		if (area->status == FRU_AREA_ABSENT)
+			continue;
+
+		fru_offset = area->offset;
+		*buf_idx = fru_offset;
+		length = 0;
+
+		/* the area header must fit, areas sit at their offset in buffer */
+		if (fru_offset + sizeof(AREA_HEADER) > MAX_EEPROM_SZ)
+		{
+			log_fnc_err(UNKNOWN_ERROR, "%s offset (%d) exceeded %d\n", fru_area_name(READ_AREAS[i]), fru_offset, MAX_EEPROM_SZ);
+			continue;
+		}
+
+		if ((response = read_fru_area(handle, slave_addr, &fru_offset, buf_idx, &length, buffer)) != SUCCESS)
+			log_fnc_err(UNKNOWN_ERROR, "fru area %s read_fru_area() failed.", fru_area_name(READ_AREAS[i]));
+
+		if (*buf_idx > image_end)
+			image_end = *buf_idx;
+	}
+
+	*buf_idx = image_end;
+
+	return response;
+}
+
+/*
+serves the image from the cache when the common header in buffer and
+the area length and check sum bytes on the device match the cached
+fingerprint.
+*/
+static int read_from_cache(int32_t handle, uint8_t channel, uint8_t slave_addr,
+	uint8_t *buffer, uint16_t *length)
+{
+	FRU_CACHE cache;
+	uint8_t probe[FRU_CACHE_PROBES];
+	I2C_SEGMENT segments[FRU_CACHE_PROBES];
+	uint8_t i;
+
+	if (fru_cache_load(channel, slave_addr, &cache) != SUCCESS)
+		return FAILURE;
+
+	if (memcmp(cache.image, buffer, sizeof(FRU_HEADER)) != 0)
+		return FAILURE;
+
+	for (i = 0; i < cache.probe_count; i++) {
+		segments[i].offset = cache.probe_offset[i];
+		segments[i].length = sizeof(uint8_t);
+		segments[i].buffer = &probe[i];
+	}
+
+	if ((*i2c_read_segments)(handle, slave_addr, cache.probe_count, segments) != SUCCESS)
+		return FAILURE;
+
+	if (memcmp(probe, cache.probe_value, cache.probe_count) != 0)
+		return FAILURE;
+
+	memcpy(buffer, cache.image, cache.length);
+	*length = cache.length;
+
+	return SUCCESS;
+}
+
+/*
+fetches the fru image of a target into buffer, from the cache when
+unchanged.  cache receives the cache outcome.  does not print, so it
+can run on a bus worker.
+*/
+int fetch_from_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t use_cache,
+	uint8_t *buffer, uint16_t *length, uint8_t *cache)
+{
+	FRU_HEADER header;
+	memset(&header, 0, sizeof(FRU_HEADER));
+
+	FRU_CACHE entry;
+
+	uint16_t fru_offset = 0;
+	uint16_t buf_idx = 0;
+	uint8_t  write_buffer[sizeof(uint16_t)];
+
+	int response = 0;
+	// copy the start offset to the write buffer
+	memcpy(write_buffer, &fru_offset, sizeof(uint16_t));
+
+	*length = 0;
+	*cache = FRU_CACHE_OFF;
+
+	int32_t handle = 0;
+	// open i2c bus
+	if ((response = open_i2c_channel(channel, &handle)) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
+		return response;
+	}
+
+	// i2c read fru header
+	if ((response = (*i2c_write_read)(handle, slave_addr, sizeof(uint16_t), write_buffer, sizeof(FRU_HEADER), &buffer[buf_idx])) == SUCCESS)
+	{
+		memcpy(&header, &buffer[buf_idx], sizeof(FRU_HEADER));
+		buf_idx += sizeof(FRU_HEADER);
+
+		if (use_cache && read_from_cache(handle, channel, slave_addr, buffer, &buf_idx) == SUCCESS)
+		{
+			*cache = FRU_CACHE_HIT;
+		}
+		else
+		{
+			if (use_cache)
+				*cache = FRU_CACHE_MISS;
+
+			response = read_fru_areas(handle, slave_addr, &header, buffer, &buf_idx);
+
+			if (response == SUCCESS && use_cache &&
+				fru_cache_fingerprint(&entry, buffer, buf_idx) == SUCCESS)
+				fru_cache_store(channel, slave_addr, &entry);
+		}
+
+		*length = buf_idx;
+	}
+
+	close_i2c_channel(handle);
+
+	return response;
+}
+
+/* prints the cache outcome of a read */
+void print_cache(uint8_t cache)
+{
+	if (cache == FRU_CACHE_HIT)
+		log_out("fru cache: hit\n");
+	else if (cache == FRU_CACHE_MISS)
+		log_out("fru cache: miss\n");
+}
+
+/* reads fru data from eeprom, or from the cache when unchanged */
+int read_from_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t use_cache) {
+
+	print_msg("reading from eeprom", NULL);
+
+	uint8_t *buffer;
+	buffer = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
+
+	uint16_t length = 0;
+	uint8_t cache = FRU_CACHE_OFF;
+	int response = 0;
+
+	if ((response = fetch_from_eeprom(channel, slave_addr, use_cache, buffer, &length, &cache)) == SUCCESS)
+	{
+		print_cache(cache);
+		response = read_fru_from_buffer(buffer, length);
+	}
+
+	free(buffer);
+
+	print_msg("eeprom read", &response);
+
+	return response;
+}
+
+/* writes a buffer to eeprom */
+int write_to_eeprom(uint8_t channel, uint8_t slave_addr, uint16_t fru_offset, uint16_t write_length, uint8_t* buffer)
+{
+	int32_t response = SUCCESS;
+	uint8_t write_buf[sizeof(uint16_t)];
+	I2C_SEGMENT chunks[MAX_WRITE_CHUNKS];
+	int chunk_count = 0;
+	int chunk;
+
+	if (write_length > MAX_EEPROM_SZ){
+		log_fnc_err(UNKNOWN_ERROR, "fru data length cannot exceed maximum write length: %d.", MAX_EEPROM_SZ);
+		return FAILURE;
+	}
+
+	/* fill whole pages, never wrapping inside one */
+	chunk_count = i2c_plan_write(fru_offset, write_length, eeprom_page_size, buffer, chunks, MAX_WRITE_CHUNKS);
+	if (chunk_count < SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to plan write for page size: %d.", eeprom_page_size);
+		return FAILURE;
+	}
+
+	/* any cached image is stale once the device is written */
+	if (fru_cache_invalidate(channel, slave_addr) != SUCCESS)
+		return FAILURE;
+
+	int32_t handle = 0;
+	// open i2c bus
+	if (open_i2c_channel(channel, &handle) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
+		return FAILURE;
+	}
+
+	for (chunk = 0; chunk < chunk_count; chunk++)
+	{
+		log_out(". ");
+
+		// copy the start offset to the write buffer
+		memset(write_buf, 0, sizeof(uint16_t));
+		memcpy(write_buf, &chunks[chunk].offset, sizeof(uint16_t));
+
+		if ((response = (*i2c_write)(handle, slave_addr, sizeof(uint16_t), write_buf,
+				(uint8_t)chunks[chunk].length, chunks[chunk].buffer)) != SUCCESS)
+			goto end;
+	}
+	log_out("\n");
+
+	end:
+
+	close_i2c_channel(handle);
+
+	return response;
+}
+
+/* marks the image bytes covered by the areas read from the device */
+static void mark_areas_read(uint8_t *image, uint16_t length, uint8_t *known)
+{
+	FRU_INDEX index;
+	FRU_AREA *area;
+	uint8_t i;
+
+	if (fru_index_build(image, length, &index) != SUCCESS)
+		return;
+
+	memset(known, 1, sizeof(FRU_HEADER));
+
+	for (i = 0; i < arr_size(READ_AREAS); i++) {
+		area = &index.area[READ_AREAS[i]];
+		if (area->status == FRU_AREA_OK || area->status == FRU_AREA_CHKSUM)
+			memset(&known[area->offset], 1, area->length);
+	}
+}
+
+/*
+writes only the eeprom pages whose content differs from the new
+image.  the current content is read through the fru area path;
+bytes outside the header and areas are unknown and always written.
+*/
+int write_changed_pages(uint8_t channel, uint8_t slave_addr, uint16_t write_length, uint8_t* buffer)
+{
+	uint8_t *current;
+	uint8_t *known;
+	uint16_t current_length = 0;
+	uint16_t page_start = 0;
+	uint16_t page_end = 0;
+	uint16_t run_start = 0;
+	uint16_t run_end = 0;
+	uint16_t pages = 0;
+	uint16_t skipped = 0;
+	uint16_t skipped_bytes = 0;
+	uint8_t cache = FRU_CACHE_OFF;
+	uint8_t dirty = 0;
+	uint8_t in_run = 0;
+	uint16_t i;
+	int response = SUCCESS;
+
+	if (write_length > MAX_EEPROM_SZ){
+		log_fnc_err(UNKNOWN_ERROR, "fru data length cannot exceed maximum write length: %d.", MAX_EEPROM_SZ);
+		return FAILURE;
+	}
+
+	current = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
+	known = calloc(MAX_EEPROM_SZ, sizeof(uint8_t));
+
+	if (current == NULL || known == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to allocate differential write buffers");
+		response = FAILURE;
+		goto end;
+	}
+
+	if (fetch_from_eeprom(channel, slave_addr, 0, current, &current_length, &cache) == SUCCESS &&
+		current_length >= sizeof(FRU_HEADER)) {
+		mark_areas_read(current, current_length, known);
+	}
+	else {
+		log_out("differential write: current image unreadable, writing all pages\n");
+	}
+
+	/* one extra pass closes the last run of dirty pages */
+	for (page_start = 0; page_start < write_length + eeprom_page_size; page_start += eeprom_page_size)
+	{
+		page_end = page_start + eeprom_page_size;
+		if (page_end > write_length)
+			page_end = write_length;
+
+		dirty = 0;
+		for (i = page_start; i < page_end && !dirty; i++)
+			dirty = !known[i] || current[i] != buffer[i];
+
+		if (page_start < write_length) {
+			pages++;
+			if (!dirty) {
+				skipped++;
+				skipped_bytes += (page_end - page_start);
+			}
+		}
+
+		if (dirty && !in_run) {
+			run_start = page_start;
+			in_run = 1;
+		}
+		else if (!dirty && in_run) {
+			/* write the run of dirty pages before this one, never past the image */
+			run_end = page_start < write_length ? page_start : write_length;
+			if ((response = write_to_eeprom(channel, slave_addr, run_start, run_end - run_start, &buffer[run_start])) != SUCCESS)
+				goto end;
+			in_run = 0;
+		}
+	}
+
+	log_out("differential write: %d of %d pages written, %d pages (%d bytes) skipped\n",
+		pages - skipped, pages, skipped, skipped_bytes);
+
+end:
+	free(current);
+	free(known);
+
+	return response;
+}
+
+/* reads a range of the eeprom in one segmented pass */
+static int read_eeprom_range(uint8_t channel, uint8_t slave_addr, uint16_t offset, uint16_t length, uint8_t *buffer)
+{
+	I2C_SEGMENT segments[MAX_SEGMENTS];
+	int32_t handle = 0;
+	int response;
+	int count;
+
+	if ((response = open_i2c_channel(channel, &handle)) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to open i2c bus");
+		return response;
+	}
+
+	count = plan_read_segments(offset, length, buffer, segments, arr_size(segments));
+	if (count < SUCCESS)
+		response = FAILURE;
+	else
+		response = (*i2c_read_segments)(handle, slave_addr, (uint16_t)count, segments);
+
+	close_i2c_channel(handle);
+
+	return response;
+}
+
+/*
+reads the written range back in one pass and rewrites only the pages
+that differ, up to MAX_VERIFY_ROUNDS times.  a page that fails to
+write is left for the next read back to find.
+*/
+int verify_write(uint8_t channel, uint8_t slave_addr, uint16_t write_length, uint8_t* buffer)
+{
+	uint8_t *current;
+	uint16_t page_start = 0;
+	uint16_t page_length = 0;
+	uint16_t pages = (write_length + eeprom_page_size - 1) / eeprom_page_size;
+	uint16_t retried = 0;
+	uint16_t bad = 0;
+	uint8_t round;
+	int response = FAILURE;
+
+	if ((current = calloc(MAX_EEPROM_SZ, sizeof(uint8_t))) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to allocate verify buffer");
+		return FAILURE;
+	}
+
+	for (round = 0; round <= MAX_VERIFY_ROUNDS; round++) {
+		if (read_eeprom_range(channel, slave_addr, 0, write_length, current) != SUCCESS) {
+			log_out("verify: read back %d failed\n", round + 1);
+			bad = pages;
+			continue;
+		}
+
+		bad = 0;
+		for (page_start = 0; page_start < write_length; page_start += eeprom_page_size) {
+			page_length = write_length - page_start < eeprom_page_size ?
+				write_length - page_start : eeprom_page_size;
+
+			if (memcmp(&current[page_start], &buffer[page_start], page_length) == SUCCESS)
+				continue;
+
+			bad++;
+
+			/* the last read back only counts what is still wrong */
+			if (round < MAX_VERIFY_ROUNDS) {
+				log_out("verify: rewriting page at %d\n", page_start);
+				write_to_eeprom(channel, slave_addr, page_start, page_length, &buffer[page_start]);
+				retried++;
+			}
+		}
+
+		if (bad == 0) {
+			response = SUCCESS;
+			break;
+		}
+	}
+
+	if (response == SUCCESS)
+		log_out("verify: %d pages good, %d page writes retried\n", pages, retried);
+	else
+		log_out("verify: failed, %d of %d pages wrong after %d page writes retried\n", bad, pages, retried);
+
+	free(current);
+
+	return response;
+}
+
+/* prints the observed eeprom write cycle time of each device written */
+void print_write_stats(void)
+{
+	I2C_WRITE_STATS stats[I2C_MAX_DEVICES];
+	int count = i2c_get_write_stats(stats, I2C_MAX_DEVICES);
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (stats[i].writes == 0)
+			continue;
+
+		log_out("write cycle: bus %d device %02x: %d writes, avg %d us, min %d us, max %d us, %d polls, %d fixed waits\n",
+			stats[i].channel, stats[i].dev_addr, stats[i].writes,
+			(uint32_t)(stats[i].total_us / stats[i].writes), stats[i].min_us, stats[i].max_us,
+			stats[i].polls, stats[i].fallbacks);
+	}
+}
@@ -0,0 +1,64 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __fru_eeprom_h
+#define __fru_eeprom_h
+
+#include "fru.h"
+
+/*
+eeprom access and decode paths of ocs-fru: the reads, writes and
+prints the command line options are built from.  the device is
+reached through the i2c function pointers, which the caller points
+at the _prod functions before any access.
+*/
+
+/* context of eeprom_read, the open device */
+typedef struct eeprom_read_ctx
+{
+	int32_t			handle;
+	uint8_t			slave_addr;
+	uint16_t		reads;			/* bus cost, for reports */
+	uint32_t		bytes;
+} EEPROM_READ_CTX;
+
+/* eeprom write page size in bytes, set with -p */
+extern uint16_t eeprom_page_size;
+
+extern int(*i2c_write_read)(int32_t handle, uint8_t slave_addr, uint8_t write_length,
+	uint8_t* write_data, uint8_t read_length, uint8_t* buffer);
+extern int(*i2c_write)(int32_t handle, uint8_t slave_addr, uint8_t write_length,
+	uint8_t* write_data, uint8_t data_length, uint8_t* data);
+extern int(*i2c_read_segments)(int32_t handle, uint8_t slave_addr, uint16_t count,
+	I2C_SEGMENT* segments);
+
+int i2c_write_read_prod(int32_t handle, uint8_t slave_addr,
+	uint8_t write_length, uint8_t* write_data, uint8_t read_length, uint8_t* buffer);
+int i2c_write_prod(int32_t handle, uint8_t slave_addr,
+	uint8_t write_length, uint8_t *write_data, uint8_t data_length, uint8_t *buffer);
+int i2c_read_segments_prod(int32_t handle, uint8_t slave_addr,
+	uint16_t count, I2C_SEGMENT* segments);
+
+void print_area_status(FRU_INDEX *index);
+void print_cache(uint8_t cache);
+void print_write_stats(void);
+int read_fru_from_buffer(uint8_t *buffer, uint16_t length);
+int encode_fru_file(FILE *input, uint8_t *fru_data, uint16_t *length);
+
+int plan_read_segments(uint16_t fru_offset, uint16_t length, uint8_t *buffer,
+	I2C_SEGMENT *segments, uint16_t max_segments);
+int eeprom_read(void *context, uint16_t offset, uint16_t length, uint8_t *buffer);
+int fetch_from_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t use_cache,
+	uint8_t *buffer, uint16_t *length, uint8_t *cache);
+int read_from_eeprom(uint8_t channel, uint8_t slave_addr, uint8_t use_cache);
+int read_multirecords(uint8_t channel, uint8_t slave_addr, uint16_t type);
+
+int write_to_eeprom(uint8_t channel, uint8_t slave_addr, uint16_t fru_offset, uint16_t write_length, uint8_t* buffer);
+int write_changed_pages(uint8_t channel, uint8_t slave_addr, uint16_t write_length, uint8_t* buffer);
+int verify_write(uint8_t channel, uint8_t slave_addr, uint16_t write_length, uint8_t* buffer);
+
+#endif //__fru_eeprom_h
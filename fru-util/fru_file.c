@@ -0,0 +1,394 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+/* strptime */
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "fru_file.h"
+#include "fru_sup.h"
+#include "ocslog.h"
+
+#define MFG_TIME_FORMAT		"%Y-%m-%d %H:%M:%S"
+#define MFG_TIME_TEXT_LEN	32
+#define MFG_TIME_MAX		0xFFFFFF	/* three bytes of minutes */
+#define MAX_VALUE_LEN		255
+
+/* input file tag of each fru_field_id */
+static const char *FRU_TAGS[MAX_RECORDS] = {
+	"Board_MfgTime",
+	"Board_MfgName",
+	"Board_Product",
+	"Board_Serial",
+	"Board_PartNumber",
+	"Board_FruId",
+	"Board_BinaryAdd",
+	"Board_BinaryAdd",
+	"Board_Version",
+	"Board_Build",
+	"Product_Mfgr",
+	"Product_Product",
+	"Product_Model",
+	"Product_Serial",
+	"Product_AssetTag",
+	"Product_FruId",
+	"Product_SubProd",
+	"Product_Build"
+};
+
+/* slot of the tag hash, both board address fields share one tag */
+typedef struct tag_slot
+{
+	const char		*tag;
+	uint8_t			length;
+	uint8_t			id;
+} TAG_SLOT;
+
+/* tags by tag_hash, the hash has no collisions for this set */
+static const TAG_SLOT TAG_TABLE[FRU_FILE_TAG_SLOTS] = {
+	[0] = { "Product_FruId", 13, FIELD_PRODUCT_FRUID },
+	[3] = { "Product_SubProd", 15, FIELD_PRODUCT_SUBPROD },
+	[4] = { "Board_PartNumber", 16, FIELD_BOARD_PARTNUMBER },
+	[11] = { "Product_AssetTag", 16, FIELD_PRODUCT_ASSETTAG },
+	[13] = { "Board_MfgName", 13, FIELD_BOARD_MFGNAME },
+	[14] = { "Board_Build", 11, FIELD_BOARD_BUILD },
+	[16] = { "Board_Product", 13, FIELD_BOARD_PRODUCT },
+	[18] = { "Board_BinaryAdd", 15, FIELD_BOARD_ADDRESS1 },
+	[20] = { "Product_Build", 13, FIELD_PRODUCT_BUILD },
+	[21] = { "Board_MfgTime", 13, FIELD_BOARD_MFGTIME },
+	[22] = { "Product_Product", 15, FIELD_PRODUCT_PRODUCT },
+	[23] = { "Product_Model", 13, FIELD_PRODUCT_MODEL },
+	[25] = { "Board_Serial", 12, FIELD_BOARD_SERIAL },
+	[26] = { "Board_FruId", 11, FIELD_BOARD_FRUID },
+	[28] = { "Product_Mfgr", 12, FIELD_PRODUCT_MFGR },
+	[30] = { "Board_Version", 13, FIELD_BOARD_VERSION },
+	[31] = { "Product_Serial", 14, FIELD_PRODUCT_SERIAL },
+};
+
+const char *fru_file_tag(uint8_t id)
+{
+	return id < MAX_RECORDS ? FRU_TAGS[id] : "unknown";
+}
+
+/* length and two of the last three characters tell every tag apart */
+static uint8_t tag_hash(const char *tag, size_t length)
+{
+	return (uint8_t)(((length * 3) + tag[length - 1] + tag[length - 3]) & (FRU_FILE_TAG_SLOTS - 1));
+}
+
+/* returns the fru_field_id of a tag, or FAILURE */
+int fru_file_tag_lookup(const char *tag, size_t length)
+{
+	const TAG_SLOT *slot;
+
+	if (length < 3 || length >= MAX_NAME_LEN)
+		return FAILURE;
+
+	slot = &TAG_TABLE[tag_hash(tag, length)];
+
+	if (slot->tag == NULL || slot->length != length || memcmp(slot->tag, tag, length) != 0)
+		return FAILURE;
+
+	return slot->id;
+}
+
+/*
+prints a parse error against its line, 0 for the whole file, so the
+operator sees every error of the file at once.
+*/
+static void file_error(FRU_FILE *file, uint32_t line, const char *message, const char *detail)
+{
+	file->errors++;
+
+	if (file->errors <= FRU_FILE_MAX_ERRORS && line == 0)
+		log_out("fru file: %s%s\n", message, detail);
+	else if (file->errors <= FRU_FILE_MAX_ERRORS)
+		log_out("line %u: %s%s\n", line, message, detail);
+	else if (file->errors == FRU_FILE_MAX_ERRORS + 1)
+		log_out("fru file: too many errors, not reporting more\n");
+}
+
+/* manufacture time as minutes since 1996, an empty value is now */
+static int parse_mfg_time(const char *value, size_t length, uint32_t *mfg_time)
+{
+	char text[MFG_TIME_TEXT_LEN];
+	struct tm mfgtime;
+	const char *end;
+	time_t seconds;
+	int now;
+
+	if (length == 0) {
+		if ((now = current_time()) < SUCCESS)
+			return FAILURE;
+		*mfg_time = (uint32_t)now;
+		return SUCCESS;
+	}
+
+	if (length >= sizeof(text))
+		return FAILURE;
+
+	memcpy(text, value, length);
+	text[length] = '\0';
+
+	memset(&mfgtime, 0, sizeof(struct tm));
+	end = strptime(text, MFG_TIME_FORMAT, &mfgtime);
+	if (end == NULL || *end != '\0')
+		return FAILURE;
+
+	mfgtime.tm_isdst = -1;
+	seconds = mktime(&mfgtime);
+
+	if (seconds == (time_t)-1 || seconds < UNIX_TSEC_1970_1996 ||
+		((seconds - UNIX_TSEC_1970_1996) / 60) > MFG_TIME_MAX)
+		return FAILURE;
+
+	*mfg_time = (uint32_t)((seconds - UNIX_TSEC_1970_1996) / 60);
+
+	return SUCCESS;
+}
+
+/*
+encodes a file field in the densest type that holds it.  the board
+address fields are hex mac addresses and are stored as binary, other
+text falls back to the text types.
+*/
+static int encode_field(uint8_t id, const char *text, uint8_t length, uint8_t *field)
+{
+	int encoded = FAILURE;
+
+	if ((id == FIELD_BOARD_ADDRESS1 || id == FIELD_BOARD_ADDRESS2) && length > 0)
+		encoded = fru_field_encode_binary(text, length, field);
+
+	if (encoded < SUCCESS)
+		encoded = fru_field_encode(text, length, field);
+
+	return encoded;
+}
+
+/*
+sets the field of a tag from its value, for a file line or a manifest
+column.  line is reported with any error.
+*/
+int fru_file_set(FRU_FILE *file, uint32_t line, const char *tag, size_t tag_length,
+	const char *value, size_t length)
+{
+	char name[MAX_NAME_LEN];
+	FRU_FILE_FIELD *field;
+	int encoded;
+	int id;
+
+	if ((id = fru_file_tag_lookup(tag, tag_length)) < SUCCESS) {
+		snprintf(name, sizeof(name), "%.*s", (int)tag_length, tag);
+		file_error(file, line, "unknown tag ", name);
+		return FAILURE;
+	}
+
+	/* the second address tag is the second address */
+	if (id == FIELD_BOARD_ADDRESS1 && file->field[id].line != 0)
+		id = FIELD_BOARD_ADDRESS2;
+
+	field = &file->field[id];
+
+	if (field->line != 0) {
+		file_error(file, line, "duplicate tag ", FRU_TAGS[id]);
+		return FAILURE;
+	}
+
+	field->line = line;
+
+	if (id == FIELD_BOARD_MFGTIME) {
+		if (parse_mfg_time(value, length, &file->mfg_time) != SUCCESS) {
+			file_error(file, line, "invalid date, expected YYYY-MM-DD hh:mm:ss", "");
+			return FAILURE;
+		}
+		return SUCCESS;
+	}
+
+	if (length > MAX_VALUE_LEN ||
+		(encoded = encode_field((uint8_t)id, value, (uint8_t)length, field->data)) < SUCCESS) {
+		file_error(file, line, "value too long for ", FRU_TAGS[id]);
+		return FAILURE;
+	}
+
+	field->size = (uint8_t)encoded;
+
+	return SUCCESS;
+}
+
+/* parses one line, from start up to the new line at end */
+static void parse_line(FRU_FILE *file, uint32_t line, const char *start, const char *end)
+{
+	const char *separator;
+	const char *tag_end;
+
+	if (end > start && end[-1] == '\r')
+		end--;
+
+	while (start < end && (*start == ' ' || *start == '\t'))
+		start++;
+
+	if (start == end || *start == FRU_FILE_COMMENT)
+		return;
+
+	separator = memchr(start, FRU_FILE_SEPARATOR, end - start);
+	if (separator == NULL) {
+		file_error(file, line, "expected Tag:value", "");
+		return;
+	}
+
+	for (tag_end = separator; tag_end > start && (tag_end[-1] == ' ' || tag_end[-1] == '\t'); tag_end--);
+
+	fru_file_set(file, line, start, tag_end - start, separator + 1, end - (separator + 1));
+}
+
+/* checks that every tag was set, returns FAILURE after any error */
+int fru_file_finish(FRU_FILE *file)
+{
+	uint16_t errors;
+	uint8_t id;
+
+	for (id = 0; id < MAX_RECORDS; id++) {
+		if (file->field[id].line == 0)
+			file_error(file, 0, "missing tag ", FRU_TAGS[id]);
+	}
+
+	if ((errors = file->errors) > 0) {
+		log_fnc_err(UNKNOWN_ERROR, "fru file has %d errors\n", errors);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+parses a whole input file held in memory.  every error is printed with
+its line, and a missing tag is an error.  returns FAILURE when any
+error was found.
+*/
+int fru_file_parse(const char *text, size_t length, FRU_FILE *file)
+{
+	const char *end = text + length;
+	const char *eol;
+	uint32_t line = 0;
+
+	memset(file, 0, sizeof(FRU_FILE));
+
+	while (text < end) {
+		eol = memchr(text, '\n', end - text);
+		if (eol == NULL)
+			eol = end;
+
+		parse_line(file, ++line, text, eol);
+		text = eol + 1;
+	}
+
+	return fru_file_finish(file);
+}
+
+/*
+appends an info area holding the fields first to last, then the end
+marker, padding and check sum.  the board area starts with the
+manufacture time.
+*/
+static int encode_area(FRU_FILE *file, uint8_t first, uint8_t last, uint8_t *fru_data, uint16_t *idx)
+{
+	uint16_t start = *idx;
+	uint16_t area_length = 0;
+	uint8_t id;
+
+	if (!fru_oversize(start, sizeof(AREA_HEADER) + FRU_MFG_TIME_LEN))
+		return FAILURE;
+
+	fru_data[(*idx)++] = FRU_VERSION;
+	(*idx)++;
+	fru_data[(*idx)++] = FRU_LANG;
+
+	if (first == FIELD_BOARD_MFGTIME) {
+		memcpy(&fru_data[*idx], &file->mfg_time, FRU_MFG_TIME_LEN);
+		*idx += FRU_MFG_TIME_LEN;
+		first++;
+	}
+
+	for (id = first; id <= last; id++) {
+		if (!fru_oversize(*idx, file->field[id].size))
+			return FAILURE;
+
+		memcpy(&fru_data[*idx], file->field[id].data, file->field[id].size);
+		*idx += file->field[id].size;
+	}
+
+	/* end marker and check sum, padded to whole area units */
+	area_length = (*idx - start) + 2;
+	if ((area_length % FRU_AREA_UNIT) != 0)
+		area_length += FRU_AREA_UNIT - (area_length % FRU_AREA_UNIT);
+
+	if (!fru_oversize(start, area_length))
+		return FAILURE;
+
+	fru_data[(*idx)++] = FRU_AREA_STOP;
+	memset(&fru_data[*idx], 0, (start + area_length) - *idx);
+
+	fru_data[start + 1] = (uint8_t)(area_length / FRU_AREA_UNIT);
+	fru_data[start + area_length - 1] = (uint8_t)calculate_chksum(fru_data, start, start + area_length - 1);
+
+	*idx = start + area_length;
+
+	return SUCCESS;
+}
+
+/* builds the eeprom image of a parsed file: common header, board and product areas */
+int fru_file_encode(FRU_FILE *file, uint8_t *fru_data, uint16_t *length)
+{
+	FRU_HEADER header;
+	uint16_t idx = sizeof(FRU_HEADER);
+
+	memset(&header, 0, sizeof(FRU_HEADER));
+
+	header.board = (uint8_t)(idx / FRU_AREA_UNIT);
+	if (encode_area(file, FIELD_BOARD_MFGTIME, FIELD_BOARD_BUILD, fru_data, &idx) != SUCCESS)
+		return FAILURE;
+
+	header.product = (uint8_t)(idx / FRU_AREA_UNIT);
+	if (encode_area(file, FIELD_PRODUCT_MFGR, FIELD_PRODUCT_BUILD, fru_data, &idx) != SUCCESS)
+		return FAILURE;
+
+	/* common header format version and check sum */
+	header.commonheader = FRU_VERSION;
+	header.checksum = (uint8_t)calculate_chksum((uint8_t *)&header, 0, sizeof(FRU_HEADER) - 1);
+
+	memcpy(fru_data, &header, sizeof(FRU_HEADER));
+
+	*length = idx;
+
+	return SUCCESS;
+}
+
+/* maps an input file and parses it */
+int fru_file_load(FILE *input, FRU_FILE *file)
+{
+	struct stat status;
+	void *text;
+	int rc;
+
+	if (fstat(fileno(input), &status) != SUCCESS || !S_ISREG(status.st_mode) || status.st_size == 0) {
+		log_fnc_err(UNKNOWN_ERROR, "fru file is empty or not a regular file\n");
+		return FAILURE;
+	}
+
+	text = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+	if (text == MAP_FAILED) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to map fru file\n");
+		return FAILURE;
+	}
+
+	rc = fru_file_parse(text, status.st_size, file);
+
+	munmap(text, status.st_size);
+
+	return rc;
+}
@@ -0,0 +1,48 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __fru_file_h
+#define __fru_file_h
+
+#include "fru.h"
+
+/*
+fru input file: one "Tag:value" line per field, in any order.  blank
+lines and lines starting with '#' are skipped.  the value runs from
+the colon to the end of the line, spaces included.
+*/
+#define FRU_FILE_COMMENT	'#'
+#define FRU_FILE_SEPARATOR	':'
+#define FRU_FILE_TAG_SLOTS	32		/* perfect hash of the tags */
+#define FRU_FILE_MAX_ERRORS	64		/* errors reported before giving up */
+
+/* one field of the input file, encoded for the eeprom */
+typedef struct fru_file_field
+{
+	uint32_t		line;			/* 0 when the tag is missing */
+	uint8_t			size;			/* encoded bytes, type/length byte included */
+	uint8_t			data[FRU_FIELD_MAX + 1];
+} FRU_FILE_FIELD;
+
+/* parsed input file, fields indexed by fru_field_id */
+typedef struct fru_file
+{
+	uint32_t		mfg_time;		/* minutes since 1996-01-01 */
+	FRU_FILE_FIELD	field[MAX_RECORDS];
+	uint16_t		errors;
+} FRU_FILE;
+
+const char *fru_file_tag(uint8_t id);
+int fru_file_tag_lookup(const char *tag, size_t length);
+int fru_file_set(FRU_FILE *file, uint32_t line, const char *tag, size_t tag_length,
+	const char *value, size_t length);
+int fru_file_finish(FRU_FILE *file);
+int fru_file_parse(const char *text, size_t length, FRU_FILE *file);
+int fru_file_encode(FRU_FILE *file, uint8_t *fru_data, uint16_t *length);
+int fru_file_load(FILE *input, FRU_FILE *file);
+
+#endif //__fru_file_h
@@ -0,0 +1,684 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "fru_manifest.h"
+#include "fru_file.h"
+#include "ocslog.h"
+
+#define MANIFEST_QUOTE		'"'
+#define MANIFEST_SEPARATOR	','
+#define MANIFEST_NOT_SET	-1
+
+/* one row of the manifest, values point into the manifest text */
+typedef struct manifest_row
+{
+	uint32_t		line;
+	uint32_t		count;
+	uint32_t		start;
+	char			*value[MANIFEST_MAX_COLUMNS];
+} MANIFEST_ROW;
+
+/* one board to build, filled in by the worker that takes it */
+typedef struct manifest_board
+{
+	uint32_t		row;
+	uint32_t		number;
+	uint16_t		length;
+	int				status;
+	char			name[MANIFEST_NAME_LEN];
+} MANIFEST_BOARD;
+
+typedef struct manifest
+{
+	const char		*directory;
+	char			*text;
+	uint8_t			columns;
+	char			*column[MANIFEST_MAX_COLUMNS];
+	int				name_column;
+	int				count_column;
+	int				start_column;
+	MANIFEST_ROW	*rows;
+	uint32_t		row_count;
+	MANIFEST_BOARD	*boards;
+	uint32_t		board_count;
+	uint32_t		next;				/* next board to take, atomic */
+	uint8_t			pass;				/* 0 builds, 1 publishes */
+	uint8_t			publish;			/* every board built, keep the images */
+} MANIFEST;
+
+/* reads the whole manifest into a nul terminated buffer */
+static char *load_text(const char *path, size_t *length)
+{
+	struct stat status;
+	char *text = NULL;
+	FILE *input;
+
+	if ((input = fopen(path, "r")) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "can't open manifest: %s", path);
+		return NULL;
+	}
+
+	if (fstat(fileno(input), &status) != SUCCESS || !S_ISREG(status.st_mode) || status.st_size == 0) {
+		log_fnc_err(UNKNOWN_ERROR, "manifest is empty or not a regular file: %s", path);
+	}
+	else if ((text = malloc(status.st_size + 1)) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to allocate manifest");
+	}
+	else if (fread(text, 1, status.st_size, input) != (size_t)status.st_size) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to read manifest: %s", path);
+		free(text);
+		text = NULL;
+	}
+	else {
+		text[status.st_size] = '\0';
+		*length = status.st_size;
+	}
+
+	fclose(input);
+
+	return text;
+}
+
+/*
+splits a csv line into nul terminated values in place.  quoted values
+may hold commas and "" for a quote.  end is the new line, or the nul
+after the last line.  returns the value count or FAILURE.
+*/
+static int split_line(char *start, char *end, char **values, uint8_t max_values)
+{
+	char *read = start;
+	char *write = start;
+	int count = 0;
+	char c;
+
+	if (end > start && end[-1] == '\r')
+		end--;
+
+	for (;;) {
+		if (count >= max_values)
+			return FAILURE;
+
+		values[count++] = write;
+
+		if (read < end && *read == MANIFEST_QUOTE) {
+			for (read++; ; read++) {
+				if (read >= end)
+					return FAILURE;
+				if (*read == MANIFEST_QUOTE && read + 1 < end && read[1] == MANIFEST_QUOTE)
+					*write++ = *read++;
+				else if (*read == MANIFEST_QUOTE)
+					break;
+				else
+					*write++ = *read;
+			}
+			read++;
+
+			if (read < end && *read != MANIFEST_SEPARATOR)
+				return FAILURE;
+		}
+		else {
+			while (read < end && *read != MANIFEST_SEPARATOR)
+				*write++ = *read++;
+		}
+
+		/* the separator may sit under write, read it first */
+		c = read < end ? *read : '\0';
+		*write++ = '\0';
+		read++;
+
+		if (c != MANIFEST_SEPARATOR)
+			return count;
+	}
+}
+
+/* finds the special columns and checks every fru tag has one */
+static int parse_header(MANIFEST *manifest, uint32_t line)
+{
+	uint8_t seen[MAX_RECORDS];
+	int rc = SUCCESS;
+	int id;
+	uint8_t c;
+
+	memset(seen, 0, sizeof(seen));
+	manifest->name_column = MANIFEST_NOT_SET;
+	manifest->count_column = MANIFEST_NOT_SET;
+	manifest->start_column = MANIFEST_NOT_SET;
+
+	for (c = 0; c < manifest->columns; c++) {
+		const char *column = manifest->column[c];
+
+		if (strcmp(column, MANIFEST_NAME) == SUCCESS) {
+			manifest->name_column = c;
+			continue;
+		}
+		if (strcmp(column, MANIFEST_COUNT) == SUCCESS) {
+			manifest->count_column = c;
+			continue;
+		}
+		if (strcmp(column, MANIFEST_START) == SUCCESS) {
+			manifest->start_column = c;
+			continue;
+		}
+
+		if ((id = fru_file_tag_lookup(column, strlen(column))) < SUCCESS) {
+			log_out("manifest line %u: unknown column %s\n", line, column);
+			rc = FAILURE;
+			continue;
+		}
+
+		/* the second address tag is the second address */
+		if (id == FIELD_BOARD_ADDRESS1 && seen[id])
+			id = FIELD_BOARD_ADDRESS2;
+
+		if (seen[id]) {
+			log_out("manifest line %u: duplicate column %s\n", line, column);
+			rc = FAILURE;
+		}
+		seen[id] = 1;
+	}
+
+	if (manifest->name_column == MANIFEST_NOT_SET) {
+		log_out("manifest line %u: missing column %s\n", line, MANIFEST_NAME);
+		rc = FAILURE;
+	}
+
+	for (id = 0; id < MAX_RECORDS; id++) {
+		if (!seen[id]) {
+			log_out("manifest line %u: missing column %s\n", line, fru_file_tag((uint8_t)id));
+			rc = FAILURE;
+		}
+	}
+
+	return rc;
+}
+
+/* reads an optional numeric column of a row */
+static int parse_number(MANIFEST *manifest, MANIFEST_ROW *row, int column, uint32_t *number)
+{
+	char *end;
+
+	if (column == MANIFEST_NOT_SET || row->value[column][0] == '\0')
+		return SUCCESS;
+
+	*number = strtoul(row->value[column], &end, 10);
+	if (*end != '\0') {
+		log_out("manifest line %u: invalid %s %s\n", row->line, manifest->column[column],
+			row->value[column]);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/* splits the manifest into the header and rows, and counts the boards */
+static int parse_manifest(MANIFEST *manifest, size_t length)
+{
+	char *text = manifest->text;
+	char *end = text + length;
+	char *values[MANIFEST_MAX_COLUMNS];
+	MANIFEST_ROW *row;
+	uint32_t line = 0;
+	uint32_t boards = 0;
+	uint32_t capacity = 0;
+	int rc = SUCCESS;
+	char *eol;
+	int count;
+
+	for (; text < end; text = eol + 1) {
+		line++;
+
+		if ((eol = memchr(text, '\n', end - text)) == NULL)
+			eol = end;
+
+		if (text == eol || *text == '\r' || *text == FRU_FILE_COMMENT)
+			continue;
+
+		count = split_line(text, eol, values, MANIFEST_MAX_COLUMNS);
+
+		if (manifest->columns == 0) {
+			if (count < SUCCESS) {
+				log_out("manifest line %u: invalid header\n", line);
+				return FAILURE;
+			}
+
+			manifest->columns = (uint8_t)count;
+			memcpy(manifest->column, values, count * sizeof(char *));
+
+			if (parse_header(manifest, line) != SUCCESS)
+				return FAILURE;
+			continue;
+		}
+
+		if (count != manifest->columns) {
+			log_out("manifest line %u: expected %u values\n", line, manifest->columns);
+			rc = FAILURE;
+			continue;
+		}
+
+		if (manifest->row_count == capacity) {
+			capacity = capacity == 0 ? 64 : capacity * 2;
+			row = realloc(manifest->rows, capacity * sizeof(MANIFEST_ROW));
+			if (row == NULL) {
+				log_fnc_err(UNKNOWN_ERROR, "unable to allocate manifest rows");
+				return FAILURE;
+			}
+			manifest->rows = row;
+		}
+
+		row = &manifest->rows[manifest->row_count++];
+		row->line = line;
+		row->count = 1;
+		row->start = 1;
+		memcpy(row->value, values, count * sizeof(char *));
+
+		if (parse_number(manifest, row, manifest->count_column, &row->count) != SUCCESS ||
+			parse_number(manifest, row, manifest->start_column, &row->start) != SUCCESS) {
+			rc = FAILURE;
+			continue;
+		}
+
+		if (row->count == 0 || row->count > MANIFEST_MAX_BOARDS - boards) {
+			log_out("manifest line %u: more than %u boards\n", line, MANIFEST_MAX_BOARDS);
+			return FAILURE;
+		}
+
+		boards += row->count;
+	}
+
+	if (manifest->columns == 0 || boards == 0) {
+		log_out("manifest: no boards\n");
+		return FAILURE;
+	}
+
+	manifest->board_count = boards;
+
+	return rc;
+}
+
+/*
+copies a value, replacing {n} with the board number and {n:W} with
+the number zero padded to W digits.  returns the length or FAILURE
+when the result does not fit.
+*/
+static int expand_value(const char *value, uint32_t number, char *out, size_t size)
+{
+	const char *close = NULL;
+	size_t length = 0;
+	int width;
+	int written;
+
+	while (*value != '\0') {
+		width = -1;
+
+		if (strncmp(value, "{n}", 3) == SUCCESS) {
+			width = 0;
+			close = value + 2;
+		}
+		else if (strncmp(value, "{n:", 3) == SUCCESS && (close = strchr(value, '}')) != NULL) {
+			width = atoi(value + 3);
+			if (width < 1 || width > 10)
+				width = -1;
+		}
+
+		if (width >= 0) {
+			written = snprintf(&out[length], size - length, "%0*u", width, number);
+			if (written < 0 || (size_t)written >= size - length)
+				return FAILURE;
+
+			length += written;
+			value = close + 1;
+			continue;
+		}
+
+		if (length + 1 >= size)
+			return FAILURE;
+
+		out[length++] = *value++;
+	}
+
+	out[length] = '\0';
+
+	return (int)length;
+}
+
+/* writes an image to a new file */
+static int write_image(const char *path, const uint8_t *data, uint16_t length)
+{
+	ssize_t written;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return FAILURE;
+
+	while (length > 0) {
+		if ((written = write(fd, data, length)) <= 0) {
+			close(fd);
+			return FAILURE;
+		}
+		data += written;
+		length -= (uint16_t)written;
+	}
+
+	return close(fd) == SUCCESS ? SUCCESS : FAILURE;
+}
+
+/* expands the name of a board, the image is <dir>/<name>.bin */
+static int expand_name(MANIFEST *manifest, MANIFEST_BOARD *board)
+{
+	MANIFEST_ROW *row = &manifest->rows[board->row];
+
+	if (expand_value(row->value[manifest->name_column], board->number,
+		board->name, sizeof(board->name)) <= 0 || strpbrk(board->name, "/,\"") != NULL) {
+		log_out("manifest line %u: invalid name %s\n", row->line, row->value[manifest->name_column]);
+		board->name[0] = '\0';
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp((*(MANIFEST_BOARD * const *)a)->name, (*(MANIFEST_BOARD * const *)b)->name);
+}
+
+/*
+expands every board name and checks no two boards share an image,
+before any worker starts.  values are checked as the workers encode.
+*/
+static int check_names(MANIFEST *manifest)
+{
+	MANIFEST_BOARD **sorted;
+	uint32_t failed = 0;
+	uint32_t i;
+
+	for (i = 0; i < manifest->board_count; i++) {
+		if (expand_name(manifest, &manifest->boards[i]) != SUCCESS)
+			failed++;
+	}
+
+	if ((sorted = malloc(manifest->board_count * sizeof(MANIFEST_BOARD *))) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to allocate manifest boards");
+		return FAILURE;
+	}
+
+	for (i = 0; i < manifest->board_count; i++)
+		sorted[i] = &manifest->boards[i];
+
+	qsort(sorted, manifest->board_count, sizeof(MANIFEST_BOARD *), compare_names);
+
+	for (i = 1; i < manifest->board_count; i++) {
+		if (sorted[i]->name[0] != '\0' && strcmp(sorted[i]->name, sorted[i - 1]->name) == SUCCESS) {
+			log_out("manifest line %u: duplicate name %s, board %u of line %u has it\n",
+				manifest->rows[sorted[i]->row].line, sorted[i]->name, sorted[i - 1]->number,
+				manifest->rows[sorted[i - 1]->row].line);
+			failed++;
+		}
+	}
+
+	free(sorted);
+
+	if (failed > 0) {
+		log_out("manifest: %u errors, no images written\n", failed);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+expands the values of a board and encodes it.  every error is printed
+with the manifest line, fru_file_set reports bad values.
+*/
+static int encode_board(MANIFEST *manifest, MANIFEST_BOARD *board, uint8_t *fru_data)
+{
+	MANIFEST_ROW *row = &manifest->rows[board->row];
+	char value[MANIFEST_VALUE_LEN];
+	FRU_FILE file;
+	int rc = SUCCESS;
+	int length;
+	uint8_t c;
+
+	memset(&file, 0, sizeof(FRU_FILE));
+
+	for (c = 0; c < manifest->columns; c++) {
+		if (c == manifest->name_column || c == manifest->count_column || c == manifest->start_column)
+			continue;
+
+		if ((length = expand_value(row->value[c], board->number, value, sizeof(value))) < SUCCESS) {
+			log_out("manifest line %u: value too long for %s\n", row->line, manifest->column[c]);
+			rc = FAILURE;
+			continue;
+		}
+
+		if (fru_file_set(&file, row->line, manifest->column[c], strlen(manifest->column[c]), value, length) != SUCCESS)
+			rc = FAILURE;
+	}
+
+	if (rc != SUCCESS || fru_file_finish(&file) != SUCCESS)
+		return FAILURE;
+
+	if (fru_file_encode(&file, fru_data, &board->length) != SUCCESS) {
+		log_out("manifest line %u: %s too large for the eeprom\n", row->line, board->name);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/* image path of a board, the temporary one until every board is built */
+static void board_path(MANIFEST *manifest, MANIFEST_BOARD *board, uint8_t temporary, char *path)
+{
+	snprintf(path, PATH_MAX, "%s/%s.bin%s", manifest->directory, board->name,
+		temporary ? MANIFEST_TEMP : "");
+}
+
+/* encodes a board and writes it to its temporary image */
+static int build_board(MANIFEST *manifest, MANIFEST_BOARD *board)
+{
+	MANIFEST_ROW *row = &manifest->rows[board->row];
+	uint8_t fru_data[MAX_EEPROM_SZ];
+	char path[PATH_MAX];
+
+	if (encode_board(manifest, board, fru_data) != SUCCESS)
+		return FAILURE;
+
+	board_path(manifest, board, 1, path);
+
+	if (write_image(path, fru_data, board->length) != SUCCESS) {
+		log_out("manifest line %u: unable to write %s\n", row->line, path);
+		unlink(path);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/* moves a built board to its image, or drops its temporary image */
+static int publish_board(MANIFEST *manifest, MANIFEST_BOARD *board)
+{
+	char temporary[PATH_MAX];
+	char path[PATH_MAX];
+
+	if (board->status != SUCCESS)
+		return board->status;
+
+	board_path(manifest, board, 1, temporary);
+
+	if (!manifest->publish) {
+		unlink(temporary);
+		return board->status;
+	}
+
+	board_path(manifest, board, 0, path);
+
+	if (rename(temporary, path) != SUCCESS) {
+		log_out("manifest line %u: unable to write %s\n", manifest->rows[board->row].line, path);
+		unlink(temporary);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+builds boards until none are left, then in the second pass publishes
+or drops the temporary images.
+*/
+static void *manifest_worker(void *arg)
+{
+	MANIFEST *manifest = (MANIFEST *)arg;
+	MANIFEST_BOARD *board;
+	uint32_t i;
+
+	while ((i = __sync_fetch_and_add(&manifest->next, 1)) < manifest->board_count) {
+		board = &manifest->boards[i];
+		board->status = manifest->pass == 0 ? build_board(manifest, board) : publish_board(manifest, board);
+	}
+
+	return NULL;
+}
+
+/* runs one worker pass over every board, returns the threads used */
+static uint32_t run_workers(MANIFEST *manifest, uint32_t threads)
+{
+	pthread_t workers[MANIFEST_MAX_THREADS];
+	uint32_t started;
+	uint32_t i;
+
+	manifest->next = 0;
+
+	for (started = 0; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, manifest_worker, manifest) != SUCCESS)
+			break;
+	}
+
+	/* with no threads the boards are built inline */
+	if (started == 0)
+		manifest_worker(manifest);
+
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	return started;
+}
+
+/* lists every board in manifest order */
+static int write_index(MANIFEST *manifest)
+{
+	char path[PATH_MAX];
+	MANIFEST_BOARD *board;
+	FILE *index;
+	uint32_t i;
+
+	snprintf(path, sizeof(path), "%s/%s", manifest->directory, MANIFEST_INDEX);
+
+	if ((index = fopen(path, "w")) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to write manifest index: %s", path);
+		return FAILURE;
+	}
+
+	fprintf(index, "name,line,number,length,status\n");
+
+	for (i = 0; i < manifest->board_count; i++) {
+		board = &manifest->boards[i];
+		fprintf(index, "%s,%u,%u,%u,%s\n", board->name, manifest->rows[board->row].line,
+			board->number, board->status == SUCCESS ? board->length : 0,
+			board->status == SUCCESS ? "ok" : "error");
+	}
+
+	return fclose(index) == SUCCESS ? SUCCESS : FAILURE;
+}
+
+/*
+builds an eeprom image for every board of a manifest, with no i2c bus.
+boards are encoded once by a pool of threads, one per core when
+threads is 0, into temporary images that are renamed only when every
+board was built.  returns FAILURE when any board failed, no image or
+index is written then.
+*/
+int fru_manifest_build(const char *path, const char *directory, uint32_t threads)
+{
+	MANIFEST manifest;
+	uint32_t started = 0;
+	uint32_t failed = 0;
+	uint32_t board = 0;
+	size_t length = 0;
+	int rc = FAILURE;
+	uint32_t i, n;
+
+	memset(&manifest, 0, sizeof(MANIFEST));
+	manifest.directory = directory;
+
+	if ((manifest.text = load_text(path, &length)) == NULL)
+		return FAILURE;
+
+	if (parse_manifest(&manifest, length) != SUCCESS)
+		goto manifest_end;
+
+	if ((manifest.boards = calloc(manifest.board_count, sizeof(MANIFEST_BOARD))) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to allocate manifest boards");
+		goto manifest_end;
+	}
+
+	for (i = 0; i < manifest.row_count; i++) {
+		for (n = 0; n < manifest.rows[i].count; n++, board++) {
+			manifest.boards[board].row = i;
+			manifest.boards[board].number = manifest.rows[i].start + n;
+			manifest.boards[board].status = FAILURE;
+		}
+	}
+
+	if (check_names(&manifest) != SUCCESS)
+		goto manifest_end;
+
+	if (threads == 0)
+		threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > MANIFEST_MAX_THREADS)
+		threads = MANIFEST_MAX_THREADS;
+	if (threads > manifest.board_count)
+		threads = manifest.board_count;
+
+	started = run_workers(&manifest, threads);
+
+	for (i = 0; i < manifest.board_count; i++)
+		if (manifest.boards[i].status != SUCCESS)
+			failed++;
+
+	/* a failed board drops every image, a manifest is built whole */
+	manifest.pass = 1;
+	manifest.publish = failed == 0;
+	run_workers(&manifest, threads);
+
+	if (failed > 0) {
+		log_out("manifest: %u boards failed, no images written\n", failed);
+		goto manifest_end;
+	}
+
+	for (i = 0; i < manifest.board_count; i++)
+		if (manifest.boards[i].status != SUCCESS)
+			failed++;
+
+	log_out("manifest: %u boards built, %u failed, %u threads\n",
+		manifest.board_count - failed, failed, started);
+
+	rc = write_index(&manifest);
+	if (failed > 0)
+		rc = FAILURE;
+
+manifest_end:
+	free(manifest.boards);
+	free(manifest.rows);
+	free(manifest.text);
+
+	return rc;
+}
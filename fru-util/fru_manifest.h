@@ -0,0 +1,42 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __fru_manifest_h
+#define __fru_manifest_h
+
+#include "fru.h"
+
+/*
+manifest: a csv file with a header row of column names, then one row
+per board or range of boards.  blank lines and lines starting with '#'
+are skipped, values may be double quoted.
+
+	Name		output image name, required
+	Count		boards built from the row, default 1
+	Start		first value of {n}, default 1
+	any other	a fru input file tag, every tag is required and
+				Board_BinaryAdd appears twice
+
+{n} in a value is replaced with the board number, {n:W} with the
+number zero padded to W digits.  expanded names must be unique and
+no image is kept unless every board builds.  each board is written
+to <dir>/<Name>.bin and <dir>/index.csv lists every board.
+*/
+#define MANIFEST_NAME			"Name"
+#define MANIFEST_COUNT			"Count"
+#define MANIFEST_START			"Start"
+#define MANIFEST_INDEX			"index.csv"
+#define MANIFEST_TEMP			".tmp"		/* suffix of images not yet published */
+#define MANIFEST_MAX_COLUMNS	32
+#define MANIFEST_MAX_BOARDS		1000000
+#define MANIFEST_MAX_THREADS	64
+#define MANIFEST_NAME_LEN		128
+#define MANIFEST_VALUE_LEN		256		/* expanded value, nul included */
+
+int fru_manifest_build(const char *manifest, const char *directory, uint32_t threads);
+
+#endif //__fru_manifest_h
@@ -0,0 +1,407 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <stdarg.h>
+#include <unistd.h>
+#include "fru_report.h"
+#include "fru_sup.h"
+#include "fru_cache.h"
+#include "ocslog.h"
+
+#define REPORT_CHUNK		4096
+#define MAX_AREA_FIELDS		(9 + FRU_MAX_CUSTOM)
+
+/* decoded field with its report id and json key */
+typedef struct report_field
+{
+	uint8_t			id;
+	const char		*name;
+	AREA_FIELD		*field;
+} REPORT_FIELD;
+
+static const char *CACHE_NAMES[] = { "off", "miss", "hit" };
+
+static const char *CUSTOM_NAMES[FRU_MAX_CUSTOM] = {
+	"custom1", "custom2", "custom3", "custom4",
+	"custom5", "custom6", "custom7", "custom8"
+};
+
+/* grows the report so that length more bytes fit */
+static int report_reserve(FRU_REPORT *report, uint32_t length)
+{
+	uint8_t *data;
+	uint32_t size = report->size;
+
+	if (report->length + length <= report->size)
+		return SUCCESS;
+
+	while (report->length + length > size)
+		size += REPORT_CHUNK;
+
+	data = realloc(report->data, size);
+	if (data == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "unable to grow report to %d bytes", size);
+		return FAILURE;
+	}
+
+	report->data = data;
+	report->size = size;
+
+	return SUCCESS;
+}
+
+static int report_append(FRU_REPORT *report, const void *data, uint32_t length)
+{
+	if (report_reserve(report, length) != SUCCESS)
+		return FAILURE;
+
+	memcpy(&report->data[report->length], data, length);
+	report->length += length;
+
+	return SUCCESS;
+}
+
+static int report_printf(FRU_REPORT *report, const char *format, ...)
+{
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	if (length < 0 || report_reserve(report, length + 1) != SUCCESS)
+		return FAILURE;
+
+	va_start(args, format);
+	vsnprintf((char *)&report->data[report->length], length + 1, format, args);
+	va_end(args);
+
+	report->length += length;
+
+	return SUCCESS;
+}
+
+/* appends field data as a quoted json string */
+static int report_json_string(FRU_REPORT *report, const uint8_t *data, uint8_t length)
+{
+	uint8_t i;
+
+	/* worst case every byte is \u00XX */
+	if (report_reserve(report, (length * 6) + 3) != SUCCESS)
+		return FAILURE;
+
+	report->data[report->length++] = '"';
+
+	for (i = 0; i < length; i++) {
+		if (data[i] == '"' || data[i] == '\\') {
+			report->data[report->length++] = '\\';
+			report->data[report->length++] = data[i];
+		}
+		else if (data[i] < 0x20 || data[i] > 0x7E) {
+			report->length += sprintf((char *)&report->data[report->length], "\\u%04x", data[i]);
+		}
+		else {
+			report->data[report->length++] = data[i];
+		}
+	}
+
+	report->data[report->length++] = '"';
+
+	return SUCCESS;
+}
+
+/*
+copies the fields present in an area, the ones before an early end
+marker are skipped, followed by its custom fields.
+*/
+static uint8_t area_fields(REPORT_FIELD *list, uint8_t list_count, uint8_t custom_id,
+	AREA_FIELD *custom, uint8_t custom_count, REPORT_FIELD *fields)
+{
+	uint8_t count = 0;
+	uint8_t i;
+
+	for (i = 0; i < list_count; i++) {
+		if (list[i].field->length != NULL)
+			fields[count++] = list[i];
+	}
+
+	for (i = 0; i < custom_count; i++) {
+		fields[count].id = custom_id;
+		fields[count].name = CUSTOM_NAMES[i];
+		fields[count].field = &custom[i];
+		count++;
+	}
+
+	return count;
+}
+
+static uint8_t chassis_fields(FRU_CHASSIS_INFO *chassis, REPORT_FIELD *fields)
+{
+	REPORT_FIELD list[] = {
+		{ FIELD_CHASSIS_PART, "part", &chassis->part },
+		{ FIELD_CHASSIS_SERIAL, "serial", &chassis->serial },
+	};
+
+	return area_fields(list, arr_size(list), FIELD_CHASSIS_CUSTOM,
+		chassis->custom, chassis->custom_count, fields);
+}
+
+static uint8_t board_fields(FRU_BOARD_INFO *board, REPORT_FIELD *fields)
+{
+	REPORT_FIELD list[] = {
+		{ FIELD_BOARD_MFGNAME, "manufacturer", &board->manufacture },
+		{ FIELD_BOARD_PRODUCT, "name", &board->name },
+		{ FIELD_BOARD_SERIAL, "serial", &board->serial },
+		{ FIELD_BOARD_PARTNUMBER, "part", &board->part },
+		{ FIELD_BOARD_FRUID, "fruid", &board->fruid },
+		{ FIELD_BOARD_ADDRESS1, "address1", &board->address1 },
+		{ FIELD_BOARD_ADDRESS2, "address2", &board->address2 },
+		{ FIELD_BOARD_VERSION, "version", &board->boardver },
+		{ FIELD_BOARD_BUILD, "build", &board->build },
+	};
+
+	return area_fields(list, arr_size(list), FIELD_BOARD_CUSTOM,
+		board->custom, board->custom_count, fields);
+}
+
+static uint8_t product_fields(FRU_PRODUCT_INFO *product, REPORT_FIELD *fields)
+{
+	REPORT_FIELD list[] = {
+		{ FIELD_PRODUCT_MFGR, "manufacturer", &product->manufacture },
+		{ FIELD_PRODUCT_PRODUCT, "name", &product->productname },
+		{ FIELD_PRODUCT_MODEL, "version", &product->productversion },
+		{ FIELD_PRODUCT_SERIAL, "serial", &product->serial },
+		{ FIELD_PRODUCT_ASSETTAG, "assettag", &product->assettag },
+		{ FIELD_PRODUCT_FRUID, "fruid", &product->fruid },
+		{ FIELD_PRODUCT_SUBPROD, "subproduct", &product->subproduct },
+		{ FIELD_PRODUCT_BUILD, "build", &product->build },
+	};
+
+	return area_fields(list, arr_size(list), FIELD_PRODUCT_CUSTOM,
+		product->custom, product->custom_count, fields);
+}
+
+/* board manufacture time as unix epoch seconds */
+static uint32_t mfg_epoch(FRU_INFO *info)
+{
+	if (!info->has_board)
+		return 0;
+
+	return (fru_mfg_minutes(&info->board) * 60) + UNIX_TSEC_1970_1996;
+}
+
+/* appends fields as json members, leading with a comma unless first */
+static int json_fields(FRU_REPORT *report, REPORT_FIELD *fields, uint8_t count, uint8_t first)
+{
+	char text[FRU_FIELD_TEXT_LEN];
+	uint16_t length;
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		length = fru_field_text(fields[i].field, text, sizeof(text));
+
+		if (report_printf(report, "%s\"%s\":{\"id\":%d,\"type\":%d,\"length\":%d,\"value\":",
+				(first && i == 0) ? "" : ",", fields[i].name, fields[i].id, fru_field_type(fields[i].field),
+				fru_field_length(fields[i].field)) != SUCCESS ||
+			report_json_string(report, (uint8_t *)text, (uint8_t)length) != SUCCESS ||
+			report_append(report, "}", 1) != SUCCESS)
+			return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+static int json_target(FRU_REPORT *report, FRU_TARGET *target, FRU_INFO *info, int status)
+{
+	REPORT_FIELD fields[MAX_AREA_FIELDS];
+	uint8_t count;
+
+	if (report_printf(report, "%s{\"channel\":%d,\"address\":\"%02x\",\"status\":%d,\"cache\":\"%s\"",
+			report->count > 0 ? "," : "", target->channel, target->slave_addr, status,
+			CACHE_NAMES[target->cache]) != SUCCESS)
+		return FAILURE;
+
+	if (status == SUCCESS && info->has_chassis) {
+		count = chassis_fields(&info->chassis, fields);
+		if (report_printf(report, ",\"chassis\":{\"type\":%d", info->chassis.type) != SUCCESS ||
+			json_fields(report, fields, count, 0) != SUCCESS ||
+			report_append(report, "}", 1) != SUCCESS)
+			return FAILURE;
+	}
+
+	if (status == SUCCESS && info->has_board) {
+		count = board_fields(&info->board, fields);
+		if (report_printf(report, ",\"board\":{\"mfg_time\":%u", mfg_epoch(info)) != SUCCESS ||
+			json_fields(report, fields, count, 0) != SUCCESS ||
+			report_append(report, "}", 1) != SUCCESS)
+			return FAILURE;
+	}
+
+	if (status == SUCCESS && info->has_product) {
+		count = product_fields(&info->product, fields);
+		if (report_printf(report, ",\"product\":{") != SUCCESS ||
+			json_fields(report, fields, count, 1) != SUCCESS ||
+			report_append(report, "}", 1) != SUCCESS)
+			return FAILURE;
+	}
+
+	return report_append(report, "}", 1);
+}
+
+static int bin_fields(FRU_REPORT *report, REPORT_FIELD *fields, uint8_t count)
+{
+	FRU_REPORT_FIELD entry;
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		entry.id = fields[i].id;
+		entry.type = fru_field_type(fields[i].field);
+		entry.length = fru_field_length(fields[i].field);
+
+		if (report_append(report, &entry, sizeof(entry)) != SUCCESS ||
+			report_append(report, fields[i].field->data, entry.length) != SUCCESS)
+			return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+static int bin_target(FRU_REPORT *report, FRU_TARGET *target, FRU_INFO *info, int status)
+{
+	REPORT_FIELD fields[MAX_AREA_FIELDS];
+	FRU_REPORT_RECORD record;
+	uint32_t start = report->length;
+	uint8_t count;
+
+	memset(&record, 0, sizeof(record));
+	record.channel = target->channel;
+	record.slave_addr = target->slave_addr;
+	record.status = (int8_t)status;
+	record.cache = target->cache;
+	record.mfgtime = status == SUCCESS ? mfg_epoch(info) : 0;
+
+	if (report_append(report, &record, sizeof(record)) != SUCCESS)
+		return FAILURE;
+
+	if (status == SUCCESS && info->has_chassis) {
+		count = chassis_fields(&info->chassis, fields);
+		record.field_count += count;
+		if (bin_fields(report, fields, count) != SUCCESS)
+			return FAILURE;
+	}
+
+	if (status == SUCCESS && info->has_board) {
+		count = board_fields(&info->board, fields);
+		record.field_count += count;
+		if (bin_fields(report, fields, count) != SUCCESS)
+			return FAILURE;
+	}
+
+	if (status == SUCCESS && info->has_product) {
+		count = product_fields(&info->product, fields);
+		record.field_count += count;
+		if (bin_fields(report, fields, count) != SUCCESS)
+			return FAILURE;
+	}
+
+	/* back fill the record now that its size is known */
+	record.length = (uint16_t)(report->length - start - sizeof(record));
+	memcpy(&report->data[start], &record, sizeof(record));
+
+	return SUCCESS;
+}
+
+/* starts an empty report */
+int report_init(FRU_REPORT *report, uint8_t output)
+{
+	FRU_REPORT_HEADER header;
+
+	memset(report, 0, sizeof(FRU_REPORT));
+	report->output = output;
+
+	if (output == FRU_OUTPUT_BIN) {
+		header.magic = FRU_REPORT_MAGIC;
+		header.version = FRU_REPORT_VERSION;
+		header.count = 0;
+		return report_append(report, &header, sizeof(header));
+	}
+
+	return report_printf(report, "{\"version\":%d,\"targets\":[", FRU_REPORT_VERSION);
+}
+
+/* decodes a fetched target and appends it to the report */
+int report_target(FRU_REPORT *report, FRU_TARGET *target)
+{
+	FRU_INFO info;
+	int status = target->response;
+	int rc;
+
+	if (status == SUCCESS && fru_decode(target->buffer, target->length, &info) != SUCCESS)
+		status = FAILURE;
+
+	if (report->output == FRU_OUTPUT_BIN)
+		rc = bin_target(report, target, &info, status);
+	else
+		rc = json_target(report, target, &info, status);
+
+	if (rc == SUCCESS)
+		report->count++;
+
+	target->response = status;
+
+	return rc;
+}
+
+/* closes the report */
+int report_finish(FRU_REPORT *report)
+{
+	if (report->output == FRU_OUTPUT_BIN) {
+		/* count sits after the magic and version */
+		report->data[sizeof(uint32_t) + sizeof(uint8_t)] = report->count;
+		return SUCCESS;
+	}
+
+	return report_printf(report, "]}\n");
+}
+
+/* writes the whole report with one write() */
+int report_flush(FRU_REPORT *report, int fd)
+{
+	uint32_t written = 0;
+	ssize_t rc;
+
+	while (written < report->length) {
+		rc = write(fd, &report->data[written], report->length - written);
+		if (rc < 0) {
+			log_fnc_err(UNKNOWN_ERROR, "report write failed");
+			return FAILURE;
+		}
+		written += rc;
+	}
+
+	return SUCCESS;
+}
+
+void report_free(FRU_REPORT *report)
+{
+	free(report->data);
+	memset(report, 0, sizeof(FRU_REPORT));
+}
+
+/* maps an -o argument to an output format */
+int report_output(const char *name)
+{
+	if (strcmp(name, "text") == SUCCESS)
+		return FRU_OUTPUT_TEXT;
+	if (strcmp(name, "json") == SUCCESS)
+		return FRU_OUTPUT_JSON;
+	if (strcmp(name, "bin") == SUCCESS)
+		return FRU_OUTPUT_BIN;
+
+	return FAILURE;
+}
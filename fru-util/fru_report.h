@@ -0,0 +1,76 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __fru_report_h
+#define __fru_report_h
+
+#include "fru.h"
+
+/* output formats */
+#define FRU_OUTPUT_TEXT		0
+#define FRU_OUTPUT_JSON		1
+#define FRU_OUTPUT_BIN		2
+
+#define FRU_REPORT_MAGIC	0x52555246	/* "FRUR" */
+#define FRU_REPORT_VERSION	1
+
+/*
+binary report layout, host byte order (little endian on the rack
+manager), no padding:
+
+	FRU_REPORT_HEADER
+	per target:
+		FRU_REPORT_RECORD	length counts the bytes after the record
+		per field:
+			FRU_REPORT_FIELD	id is a fru_field_id, the FRU_FIELDS index
+								of the tag for board and product fields,
+								absent fields are left out
+			data				length bytes, encoded as type
+*/
+PACK(typedef struct fru_report_header
+{
+	uint32_t		magic;
+	uint8_t			version;
+	uint8_t			count;
+}) FRU_REPORT_HEADER;
+
+PACK(typedef struct fru_report_record
+{
+	uint16_t		length;
+	uint8_t			channel;
+	uint8_t			slave_addr;
+	int8_t			status;
+	uint8_t			cache;
+	uint32_t		mfgtime;	/* unix epoch seconds, 0 without board area */
+	uint8_t			field_count;
+}) FRU_REPORT_RECORD;
+
+PACK(typedef struct fru_report_field
+{
+	uint8_t			id;
+	uint8_t			type;
+	uint8_t			length;
+}) FRU_REPORT_FIELD;
+
+/* report built in memory and written with a single write() */
+typedef struct fru_report
+{
+	uint8_t			output;
+	uint8_t			count;
+	uint32_t		length;
+	uint32_t		size;
+	uint8_t			*data;
+} FRU_REPORT;
+
+int report_init(FRU_REPORT *report, uint8_t output);
+int report_target(FRU_REPORT *report, FRU_TARGET *target);
+int report_finish(FRU_REPORT *report);
+int report_flush(FRU_REPORT *report, int fd);
+void report_free(FRU_REPORT *report);
+int report_output(const char *name);
+
+#endif //__fru_report_h
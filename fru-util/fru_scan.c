@@ -0,0 +1,251 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fru_scan.h"
+#include "ocslog.h"
+
+/* image problems other than area status */
+#define SCAN_OK				0
+#define SCAN_UNREADABLE		1
+#define SCAN_TOO_SHORT		2
+#define SCAN_VERSION		3
+
+static const char *SCAN_ERRORS[] = {
+	"ok", "unreadable", "shorter than the common header", "bad common header version"
+};
+
+static const char *AREA_STATUS[] = {
+	"absent", "past the end of the image", "ok", "check sum mismatch", "malformed"
+};
+
+/* one image and what the scan found */
+typedef struct scan_image
+{
+	char			*name;
+	uint8_t			error;
+	uint8_t			corrupt;
+	FRU_INDEX		index;
+} SCAN_IMAGE;
+
+typedef struct scan
+{
+	const char		*directory;
+	SCAN_IMAGE		*images;
+	uint32_t		count;
+	uint32_t		next;				/* next image to take, atomic */
+} SCAN;
+
+static int compare_images(const void *a, const void *b)
+{
+	return strcmp(((const SCAN_IMAGE *)a)->name, ((const SCAN_IMAGE *)b)->name);
+}
+
+/* lists the regular files of the directory, sorted by name */
+static int list_images(SCAN *scan)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	struct stat status;
+	SCAN_IMAGE *images;
+	uint32_t capacity = 0;
+	DIR *dir;
+
+	if ((dir = opendir(scan->directory)) == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "can't open image directory: %s", scan->directory);
+		return FAILURE;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		if (entry->d_type == DT_UNKNOWN) {
+			snprintf(path, sizeof(path), "%s/%s", scan->directory, entry->d_name);
+			if (stat(path, &status) != SUCCESS || !S_ISREG(status.st_mode))
+				continue;
+		}
+		else if (entry->d_type != DT_REG) {
+			continue;
+		}
+
+		if (scan->count == capacity) {
+			capacity = capacity == 0 ? 256 : capacity * 2;
+			if ((images = realloc(scan->images, capacity * sizeof(SCAN_IMAGE))) == NULL) {
+				log_fnc_err(UNKNOWN_ERROR, "unable to allocate image list");
+				closedir(dir);
+				return FAILURE;
+			}
+			scan->images = images;
+		}
+
+		memset(&scan->images[scan->count], 0, sizeof(SCAN_IMAGE));
+		if ((scan->images[scan->count].name = strdup(entry->d_name)) == NULL) {
+			closedir(dir);
+			return FAILURE;
+		}
+		scan->count++;
+	}
+
+	closedir(dir);
+
+	if (scan->count > 0)
+		qsort(scan->images, scan->count, sizeof(SCAN_IMAGE), compare_images);
+
+	return SUCCESS;
+}
+
+/* maps an image and indexes it, which checks every check sum */
+static void scan_image(SCAN *scan, SCAN_IMAGE *image)
+{
+	char path[PATH_MAX];
+	struct stat status;
+	uint8_t *data = MAP_FAILED;
+	size_t length = 0;
+	uint8_t area;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", scan->directory, image->name);
+
+	image->error = SCAN_UNREADABLE;
+	image->corrupt = 1;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return;
+
+	if (fstat(fd, &status) == SUCCESS) {
+		length = status.st_size > SCAN_MAX_IMAGE ? SCAN_MAX_IMAGE : (size_t)status.st_size;
+
+		if (length < sizeof(FRU_HEADER))
+			image->error = SCAN_TOO_SHORT;
+		else
+			data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return;
+
+	fru_index_build(data, (uint16_t)length, &image->index);
+
+	image->error = ((FRU_HEADER *)data)->commonheader == FRU_VERSION ? SCAN_OK : SCAN_VERSION;
+	image->corrupt = image->error != SCAN_OK || image->index.header_status != FRU_AREA_OK;
+
+	for (area = 0; area < FRU_AREA_COUNT; area++) {
+		if (image->index.area[area].status != FRU_AREA_ABSENT && image->index.area[area].status != FRU_AREA_OK)
+			image->corrupt = 1;
+	}
+
+	munmap(data, length);
+}
+
+/* scans images until none are left */
+static void *scan_worker(void *arg)
+{
+	SCAN *scan = (SCAN *)arg;
+	uint32_t image;
+
+	while ((image = __sync_fetch_and_add(&scan->next, 1)) < scan->count)
+		scan_image(scan, &scan->images[image]);
+
+	return NULL;
+}
+
+/* lists what is wrong with a corrupt image, one line per problem */
+static void print_corrupt(SCAN_IMAGE *image)
+{
+	FRU_AREA *area;
+	uint8_t i;
+
+	/* without a fru header the areas mean nothing */
+	if (image->error != SCAN_OK) {
+		log_out("corrupt: %s: %s\n", image->name, SCAN_ERRORS[image->error]);
+		return;
+	}
+
+	if (image->index.header_status != FRU_AREA_OK)
+		log_out("corrupt: %s: common header check sum mismatch\n", image->name);
+
+	for (i = 0; i < FRU_AREA_COUNT; i++) {
+		area = &image->index.area[i];
+		if (area->status != FRU_AREA_ABSENT && area->status != FRU_AREA_OK)
+			log_out("corrupt: %s: %s area at %d: %s\n", image->name, fru_area_name(i),
+				area->offset, AREA_STATUS[area->status]);
+	}
+}
+
+/*
+checks every image in a directory, on a pool of threads, one per core
+when threads is 0.  prints each corrupt image and area, then a
+summary.  returns FAILURE when any image is corrupt.
+*/
+int fru_scan_images(const char *directory, uint32_t threads)
+{
+	pthread_t workers[SCAN_MAX_THREADS];
+	struct timespec start, end;
+	uint32_t started = 0;
+	uint32_t corrupt = 0;
+	uint32_t i;
+	SCAN scan;
+
+	memset(&scan, 0, sizeof(SCAN));
+	scan.directory = directory;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (list_images(&scan) != SUCCESS) {
+		corrupt = 1;
+		goto scan_end;
+	}
+
+	if (threads == 0)
+		threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > SCAN_MAX_THREADS)
+		threads = SCAN_MAX_THREADS;
+	if (threads > scan.count)
+		threads = scan.count;
+
+	for (started = 0; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, scan_worker, &scan) != SUCCESS)
+			break;
+	}
+
+	/* with no threads the images are scanned inline */
+	if (started == 0)
+		scan_worker(&scan);
+
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (i = 0; i < scan.count; i++) {
+		if (scan.images[i].corrupt) {
+			print_corrupt(&scan.images[i]);
+			corrupt++;
+		}
+	}
+
+	log_out("scan: %u images, %u good, %u corrupt, %u threads, %ld ms\n",
+		scan.count, scan.count - corrupt, corrupt, started,
+		((end.tv_sec - start.tv_sec) * 1000) + ((end.tv_nsec - start.tv_nsec) / 1000000));
+
+scan_end:
+	for (i = 0; i < scan.count; i++)
+		free(scan.images[i].name);
+	free(scan.images);
+
+	return corrupt == 0 ? SUCCESS : FAILURE;
+}
@@ -0,0 +1,24 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __fru_scan_h
+#define __fru_scan_h
+
+#include "fru.h"
+
+/*
+integrity scan of a directory of raw eeprom images, such as those
+saved by -r raw.  every regular file is checked: common header
+version and check sum, then the check sum of every area.  files
+starting with '.' are skipped.
+*/
+#define SCAN_MAX_THREADS	64
+#define SCAN_MAX_IMAGE		0xFFFF		/* larger images are checked up to here */
+
+int fru_scan_images(const char *directory, uint32_t threads);
+
+#endif //__fru_scan_h
@@ -102,23 +102,6 @@ int validate_fru_address(uint8_t channel, uint8_t slave_addr)
 	return FAILURE;
 }
 
-/*
-calculates ones complement checksum
-*/
-int calculate_chksum(uint8_t *buffer, uint16_t offset, uint8_t end_pos) {
-
-	uint8_t chksum = 0;
-
-	for (; offset < end_pos; offset++)
-		chksum += buffer[offset];
-
-	return ~(chksum)+1;
-}
-
-int verify_chksum(uint8_t *buffer, uint16_t offset, uint8_t end_pos) {
-	return (calculate_chksum(buffer, offset, end_pos) == buffer[end_pos]) ? SUCCESS : FAILURE;
-}
-
 /*
 function to protect against fru field length overflow
 */
@@ -137,14 +120,45 @@ void usage()
 	log_out("                                   50 = board\n");
 	log_out("                                   51 = pmdu\n");
 	log_out("                                   52 = row\n");
-	log_out("		-r				Read operation.\n");
-	log_out("		-w	{file}		write operation, requires file name\n");
+	log_out("		-r				Read operation.\n");
+	log_out("		-r field={tag,...}	Read only the listed fields, tags as in the write file.\n");
+	log_out("		-r raw	{file}	Save the whole eeprom as a binary image, to stdout without file.\n");
+	log_out("		-n				Read from the device, bypassing the fru cache.\n");
+	log_out("		-M	{type,all}	List the multirecord area, decoding records of a hex type or all.\n");
+	log_out("		-m	{c:s,...}	Read a list of channel:slave targets, buses in parallel.\n");
+	log_out("		-o	{text,json,bin}	Read output format, json and bin are written in one block.\n");
+	log_out("		-w	{file}		write operation, requires file name, a text file or a binary\n");
+	log_out("				image whose check sums are verified before writing.\n");
+	log_out("		-b	{manifest}	Build an image per board of a csv manifest, no eeprom access.\n");
+	log_out("		-O	{dir}		With -b, directory for the images and index.csv, default '.'.\n");
+	log_out("		-i	{dir}		Check the header and area check sums of every image in a\n");
+	log_out("				directory, no eeprom access.\n");
+	log_out("		-j	{threads}	With -b or -i, worker threads, default one per core.\n");
+	log_out("		-d				With -w, only write pages that differ from the eeprom.\n");
+	log_out("		-v				With -w, read the image back and rewrite pages that differ.\n");
+	log_out("		-f				With -w, write a binary image even if its check sums fail.\n");
+	log_out("		-p	{8..128}	eeprom write page size in bytes, default 32.\n");
+	log_out("		-a	{usec}		bound on write cycle ack polling, 0 waits a fixed 5 ms.\n");
+	log_out("		-R	{spec}		retries of failed transactions, class=retries[:usec[:max usec]],...\n");
+	log_out("				classes nak, timeout and arbitration, the wait doubles each retry.\n");
+	log_out("		-S	{spec}		use a simulated eeprom instead of /dev/i2c-N, spec is default or\n");
+	log_out("				key=value,... of page, addr, size, txn_us, byte_us, cycle_us,\n");
+	log_out("				absent, nak_every, timeout_every, funcs (hex adapter functions),\n");
+	log_out("				max_read and dir (image directory).\n");
 	log_out("\n");
 	log_out("Write Example:\n");
 	log_out("		ocs-fru -c 0 -s 50 -w filename\n");
+	log_out("		ocs-fru -b manifest.csv -O images\n");
+	log_out("		ocs-fru -i images -j 4\n");
 	log_out("\n");
 	log_out("Read Example:\n");
-	log_out("		ocs-fru  -c 0 -s 50 -r\n");
+	log_out("		ocs-fru  -c 0 -s 50 -r\n");
+	log_out("		ocs-fru  -m 0:51,0:52,1:50 -r\n");
+	log_out("		ocs-fru  -c 0 -s 51 -r -M 0\n");
+	log_out("		ocs-fru  -c 0 -s 50 -r raw backup.bin\n");
+	log_out("		ocs-fru  -c 0 -s 50 -r field=Board_Serial,Product_AssetTag\n");
+	log_out("		ocs-fru  -S page=64,cycle_us=5000,dir=/tmp -c 0 -s 50 -r\n");
+	log_out("		ocs-fru  -R nak=10:200,timeout=0 -c 0 -s 50 -r\n");
 	log_out("\n");
 	log_out("version: %d.%d \n", VERSION_MAJOR, VERSION_MINOR);
 	log_out("build:   %d.%d \n", VERSION_REVISION, VERSION_BUILD);
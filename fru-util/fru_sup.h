@@ -23,8 +23,6 @@ uint32_t str_time_to_array(char *time_str);
 int current_time();
 
 int validate_fru_address(uint8_t channel, uint8_t slave_addr);
-int calculate_chksum(uint8_t *buffer, uint16_t offset, uint8_t end_pos);
-int verify_chksum(uint8_t *buffer, uint16_t offset, uint8_t end_pos);
 int fru_oversize(int idx, int length);
 int remove_char(uint8_t* buffer, uint8_t remove);
 void print_msg(uint8_t* message, uint32_t* code);
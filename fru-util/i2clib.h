@@ -5,16 +5,121 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#ifndef __i2clib_h
+#define __i2clib_h
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 /* i2c file location */
 #define I2C_DEV_FILE		"/dev/i2c-%d"
-#define MAX_PAGE_SIZE		32	/* 32 byte page when 2 byte address is added */
+#define MAX_PAGE_SIZE		32	/* default eeprom write page, excluding the address */
 #define MAX_PAYLOAD_LEN		16  /* FRU read/write chunk size */
+#define I2C_ADDR_LEN		2	/* eeprom word address length */
+#define I2C_MIN_PAGE_SIZE	8	/* smallest supported eeprom write page */
+#define I2C_MAX_PAGE_SIZE	128	/* largest supported eeprom write page */
+
+/* write cycle completion */
+#define I2C_WRITE_CYCLE_US	5000	/* fixed wait when ack polling is off or unsupported */
+#define I2C_ACK_POLL_US		20000	/* default bound on ack polling */
+#define I2C_ACK_POLL_GAP_US	100		/* pause between ack polls */
+#define I2C_MAX_BUSES		256		/* pooled handles, one per channel */
+#define I2C_MAX_DEVICES		32		/* devices tracked for write cycle statistics */
+
+/* adapter transfer methods, best first, probed once per bus from I2C_FUNCS */
+#define I2C_METHOD_RDWR			0	/* combined I2C_RDWR transactions */
+#define I2C_METHOD_SMBUS_BLOCK	1	/* smbus i2c block writes, byte reads */
+#define I2C_METHOD_SMBUS_BYTE	2	/* smbus byte writes and reads */
+#define I2C_MAX_READ_LEN		256	/* first read size tried, halved while the adapter refuses it */
+#define I2C_MIN_READ_LEN		MAX_PAYLOAD_LEN
+
+/* errno classes a failed transaction is retried for, each with its own policy */
+#define I2C_RETRY_NAK			0	/* EREMOTEIO, ENXIO, EIO: device busy or absent */
+#define I2C_RETRY_TIMEOUT		1	/* ETIMEDOUT: bus stuck */
+#define I2C_RETRY_ARBITRATION	2	/* EAGAIN: arbitration lost */
+#define I2C_RETRY_CLASSES		3
+#define I2C_RETRY_NONE			-1
+
+/* asynchronous requests */
+#define I2C_ASYNC_QUEUE		64		/* requests waiting per bus */
+#define I2C_ASYNC_RING		256		/* completions waiting to be reaped */
+#define I2C_OP_READ			0
+#define I2C_OP_WRITE		1
+
+/* scatter/gather read segment, or page write chunk */
+typedef struct i2c_segment
+{
+	uint16_t		offset;		/* eeprom word address */
+	uint16_t		length;		/* bytes to read */
+	uint8_t			*buffer;	/* destination */
+} I2C_SEGMENT;
 
+/* observed write cycle time of one device */
+typedef struct i2c_write_stats
+{
+	uint8_t			channel;
+	uint8_t			dev_addr;
+	uint32_t		writes;		/* page writes completed */
+	uint32_t		polls;		/* address probes issued */
+	uint32_t		fallbacks;	/* writes that used the fixed wait */
+	uint32_t		min_us;
+	uint32_t		max_us;
+	uint64_t		total_us;
+} I2C_WRITE_STATS;
+
+/* retries of one errno class, the wait doubles on each retry */
+typedef struct i2c_retry_policy
+{
+	uint16_t		retries;
+	uint32_t		backoff_us;		/* wait before the first retry */
+	uint32_t		max_backoff_us;
+} I2C_RETRY_POLICY;
+
+/* what a bus adapter can do and how it is driven */
+typedef struct i2c_profile
+{
+	uint32_t		funcs;		/* I2C_FUNCS flags */
+	uint8_t			method;		/* I2C_METHOD_ */
+	uint16_t		max_read;	/* longest read of one transaction */
+	uint16_t		max_write;	/* longest write payload of one transaction */
+} I2C_PROFILE;
+
+struct i2c_request;
+typedef void (*I2C_CALLBACK)(struct i2c_request *request);
+
+/*
+asynchronous transaction.  reads fill the segments with one combined
+transfer, writes send each segment as a page write at its offset.
+*/
+typedef struct i2c_request
+{
+	uint8_t			channel;
+	uint8_t			dev_addr;
+	uint8_t			op;			/* I2C_OP_READ or I2C_OP_WRITE */
+	uint16_t		count;		/* segments */
+	I2C_SEGMENT		*segments;
+	I2C_CALLBACK	callback;	/* run on the bus worker, else reaped */
+	void			*token;		/* caller's completion context */
+	int				result;		/* SUCCESS once complete */
+} I2C_REQUEST;
+
 int open_i2c_channel(uint8_t channel, int32_t *handle);
 int close_i2c_channel(int32_t handle);
 int i2c_block_write(int32_t handle, uint8_t dev_addr, uint16_t write_length, uint8_t *write_buf, uint16_t length, uint8_t *buffer);
 int i2c_block_read(int32_t handle, uint8_t dev_addr, uint8_t write_len, uint8_t *write_buf, uint16_t length, uint8_t *buffer);
+int i2c_block_read_segments(int32_t handle, uint8_t dev_addr, uint16_t count, I2C_SEGMENT *segments);
+int i2c_sim_configure(const char *spec);
+int i2c_sim_enabled(void);
+void i2c_set_ack_poll(uint32_t timeout_us);
+int i2c_get_write_stats(I2C_WRITE_STATS *stats, uint16_t max_stats);
+int i2c_plan_write(uint16_t offset, uint16_t length, uint16_t page_size, uint8_t *buffer, I2C_SEGMENT *chunks, uint16_t max_chunks);
+int i2c_get_profile(uint8_t channel, I2C_PROFILE *profile);
+int i2c_set_retry(uint8_t error_class, I2C_RETRY_POLICY *policy);
+int i2c_retry_configure(const char *spec);
+int i2c_async_submit(I2C_REQUEST *request);
+int i2c_async_reap(I2C_REQUEST **completed, uint16_t max, int32_t timeout_ms);
+int i2c_async_fd(void);
+void i2c_async_shutdown(void);
+
+#endif //__i2clib_h
@@ -0,0 +1,287 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+/*
+ocs-fru-bench times the ocs-fru codec and eeprom paths.  it links the
+same fru_eeprom.c ocs-fru does, so the functions are measured as
+ocs-fru runs them; the eeprom cases run against the simulated
+transport.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "fru_sup.h"
+#include "fru_file.h"
+#include "fru_eeprom.h"
+#include "ocslog.h"
+
+#define BENCH_FORMAT		1
+#define BENCH_MIN_MS		200		/* minimum measured time per case */
+#define BENCH_CHANNEL		0
+#define BENCH_ADDR			0x50
+#define BENCH_SIM			"txn_us=0,byte_us=0,cycle_us=0"
+#define BENCH_TEXT_LEN		4096
+
+/* state shared by the cases */
+typedef struct bench_ctx
+{
+	FILE			*input;
+	char			text[BENCH_TEXT_LEN];
+	size_t			text_length;
+	uint8_t			image[MAX_EEPROM_SZ];
+	uint16_t		length;
+	uint8_t			scratch[MAX_EEPROM_SZ];
+} BENCH_CTX;
+
+typedef int (*BENCH_FN)(BENCH_CTX *ctx);
+
+typedef struct bench_case
+{
+	const char		*name;
+	BENCH_FN		run;
+	uint8_t			quiet;		/* case prints, send stdout to /dev/null */
+} BENCH_CASE;
+
+static volatile uint8_t bench_sink;
+
+static int bench_decode(BENCH_CTX *ctx)
+{
+	FRU_INFO info;
+
+	return fru_decode(ctx->image, ctx->length, &info);
+}
+
+static int bench_read_buffer(BENCH_CTX *ctx)
+{
+	return read_fru_from_buffer(ctx->image, ctx->length);
+}
+
+/* the encode step of read_fru_from_file, without the eeprom write */
+static int bench_encode(BENCH_CTX *ctx)
+{
+	uint16_t length = 0;
+
+	rewind(ctx->input);
+	memset(ctx->scratch, 0, MAX_EEPROM_SZ);
+
+	return encode_fru_file(ctx->input, ctx->scratch, &length);
+}
+
+/* the input file parse alone, without mapping the file */
+static int bench_parse(BENCH_CTX *ctx)
+{
+	FRU_FILE file;
+
+	return fru_file_parse(ctx->text, ctx->text_length, &file);
+}
+
+static int bench_chksum(BENCH_CTX *ctx)
+{
+	bench_sink = calculate_chksum(ctx->image, 0, ctx->length);
+
+	return SUCCESS;
+}
+
+static int bench_write_eeprom(BENCH_CTX *ctx)
+{
+	return write_to_eeprom(BENCH_CHANNEL, BENCH_ADDR, 0, ctx->length, ctx->image);
+}
+
+static int bench_read_eeprom(BENCH_CTX *ctx)
+{
+	(void)ctx;
+
+	return read_from_eeprom(BENCH_CHANNEL, BENCH_ADDR, 0);
+}
+
+static int bench_read_multirecords(BENCH_CTX *ctx)
+{
+	(void)ctx;
+
+	return read_multirecords(BENCH_CHANNEL, BENCH_ADDR, FRU_MR_ALL);
+}
+
+static const BENCH_CASE BENCH_CASES[] = {
+	{ "fru_decode", bench_decode, 0 },
+	{ "read_fru_from_buffer", bench_read_buffer, 1 },
+	{ "encode_fru_file", bench_encode, 0 },
+	{ "fru_file_parse", bench_parse, 0 },
+	{ "calculate_chksum", bench_chksum, 0 },
+	{ "write_to_eeprom", bench_write_eeprom, 1 },
+	{ "read_from_eeprom", bench_read_eeprom, 1 },
+	{ "read_multirecords", bench_read_multirecords, 1 },
+};
+
+/* loads the image so the read cases also work on their own */
+static const BENCH_CASE BENCH_SEED = { "seed", bench_write_eeprom, 1 };
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+/* runs a case iterations times, returns the elapsed ns or 0 on error */
+static uint64_t bench_batch(const BENCH_CASE *bench, BENCH_CTX *ctx, uint64_t iterations)
+{
+	uint64_t start;
+	uint64_t elapsed;
+	uint64_t i;
+	int saved = -1;
+	int null_fd;
+	int rc = SUCCESS;
+
+	if (bench->quiet) {
+		fflush(stdout);
+		saved = dup(STDOUT_FILENO);
+		null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, STDOUT_FILENO);
+		close(null_fd);
+	}
+
+	start = now_ns();
+	for (i = 0; i < iterations && rc == SUCCESS; i++)
+		rc = bench->run(ctx);
+	elapsed = now_ns() - start;
+
+	if (bench->quiet) {
+		fflush(stdout);
+		dup2(saved, STDOUT_FILENO);
+		close(saved);
+	}
+
+	if (rc != SUCCESS) {
+		fprintf(stderr, "%s failed: %d\n", bench->name, rc);
+		return 0;
+	}
+
+	return elapsed > 0 ? elapsed : 1;
+}
+
+/* doubles the iteration count until a batch runs for min_ns */
+static int bench_run(const BENCH_CASE *bench, BENCH_CTX *ctx, uint64_t min_ns)
+{
+	uint64_t iterations = 1;
+	uint64_t elapsed = 0;
+
+	/* warm up and check the case works */
+	if (bench_batch(bench, ctx, 1) == 0)
+		return FAILURE;
+
+	while (1) {
+		if ((elapsed = bench_batch(bench, ctx, iterations)) == 0)
+			return FAILURE;
+
+		if (elapsed >= min_ns)
+			break;
+
+		iterations *= 2;
+	}
+
+	printf("%s,%llu,%llu,%.1f,%.0f\n", bench->name, (unsigned long long)iterations,
+		(unsigned long long)elapsed, (double)elapsed / iterations,
+		(iterations * 1e9) / elapsed);
+
+	return SUCCESS;
+}
+
+static void bench_usage(void)
+{
+	printf("Usage: ocs-fru-bench -f {file} [-t {ms}] [-S {spec}] [-b {name}]\n");
+	printf("		-f	{file}		fru input file, as given to ocs-fru -w\n");
+	printf("		-t	{ms}		minimum measured time per case, default %d\n", BENCH_MIN_MS);
+	printf("		-S	{spec}		simulated eeprom for the eeprom cases, default %s\n", BENCH_SIM);
+	printf("		-b	{name}		run only the named case\n");
+	printf("\n");
+	printf("output is csv: name,iterations,total_ns,ns_per_op,ops_per_sec\n");
+}
+
+int main(int argc, char **argv)
+{
+	BENCH_CTX *ctx;
+	char *filename = NULL;
+	char *sim = BENCH_SIM;
+	char *only = NULL;
+	uint64_t min_ms = BENCH_MIN_MS;
+	int response = SUCCESS;
+	int i;
+
+	for (i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-f") == SUCCESS)
+			filename = argv[i + 1];
+
+		if (strcmp(argv[i], "-t") == SUCCESS)
+			min_ms = strtoull(argv[i + 1], NULL, 10);
+
+		if (strcmp(argv[i], "-S") == SUCCESS)
+			sim = argv[i + 1];
+
+		if (strcmp(argv[i], "-b") == SUCCESS)
+			only = argv[i + 1];
+	}
+
+	if (filename == NULL || min_ms == 0) {
+		bench_usage();
+		return 1;
+	}
+
+	i2c_write_read = &i2c_write_read_prod;
+	i2c_write = &i2c_write_prod;
+	i2c_read_segments = &i2c_read_segments_prod;
+
+	if (i2c_sim_configure(sim) != SUCCESS) {
+		fprintf(stderr, "invalid simulator spec: %s\n", sim);
+		return 1;
+	}
+
+	ctx = calloc(1, sizeof(BENCH_CTX));
+	if (ctx == NULL)
+		return 1;
+
+	ctx->input = fopen(filename, "r");
+	if (ctx->input == NULL) {
+		fprintf(stderr, "can't open input file: %s\n", filename);
+		free(ctx);
+		return 1;
+	}
+
+	ctx->text_length = fread(ctx->text, 1, sizeof(ctx->text), ctx->input);
+
+	if (encode_fru_file(ctx->input, ctx->image, &ctx->length) != SUCCESS) {
+		fprintf(stderr, "can't encode input file: %s\n", filename);
+		response = FAILURE;
+		goto end;
+	}
+
+	if (bench_batch(&BENCH_SEED, ctx, 1) == 0) {
+		response = FAILURE;
+		goto end;
+	}
+
+	printf("# ocs-fru-bench format %d, image %d bytes, sim %s\n", BENCH_FORMAT, ctx->length, sim);
+	printf("name,iterations,total_ns,ns_per_op,ops_per_sec\n");
+
+	for (i = 0; i < (int)arr_size(BENCH_CASES); i++) {
+		if (only != NULL && strcmp(only, BENCH_CASES[i].name) != SUCCESS)
+			continue;
+
+		if (bench_run(&BENCH_CASES[i], ctx, min_ms * 1000000) != SUCCESS)
+			response = FAILURE;
+	}
+
+end:
+	fclose(ctx->input);
+	free(ctx);
+
+	return response == SUCCESS ? 0 : 1;
+}
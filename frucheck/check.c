@@ -0,0 +1,88 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+/*
+ocs-fru-check runs the pure planning functions of the i2c library
+against known answers, with no bus and no simulator.  one line per
+failed case, exit status 1 when any failed.
+*/
+#include <stdio.h>
+#include "i2clib.h"
+#include "ocslog.h"
+
+#define CHECK_MAX_CHUNKS	8
+#define CHECK_BUFFER_LEN	512
+
+/* a write to plan and the chunks expected, count FAILURE when refused */
+typedef struct plan_case
+{
+	const char		*name;
+	uint16_t		offset;
+	uint16_t		length;
+	uint16_t		page_size;
+	uint16_t		max_chunks;
+	int				count;
+	uint16_t		chunk[CHECK_MAX_CHUNKS][2];		/* offset, length */
+} PLAN_CASE;
+
+static const PLAN_CASE PLAN_CASES[] = {
+	{ "whole pages", 0, 64, 32, CHECK_MAX_CHUNKS, 2, { { 0, 32 }, { 32, 32 } } },
+	{ "crosses a page", 30, 10, 32, CHECK_MAX_CHUNKS, 2, { { 30, 2 }, { 32, 8 } } },
+	{ "inside a page", 33, 10, 32, CHECK_MAX_CHUNKS, 1, { { 33, 10 } } },
+	{ "8 byte pages", 5, 20, 8, CHECK_MAX_CHUNKS, 4, { { 5, 3 }, { 8, 8 }, { 16, 8 }, { 24, 1 } } },
+	{ "128 byte pages", 100, 300, 128, CHECK_MAX_CHUNKS, 4,
+		{ { 100, 28 }, { 128, 128 }, { 256, 128 }, { 384, 16 } } },
+	{ "fills max_chunks", 0, 64, 8, 8, 8,
+		{ { 0, 8 }, { 8, 8 }, { 16, 8 }, { 24, 8 }, { 32, 8 }, { 40, 8 }, { 48, 8 }, { 56, 8 } } },
+	{ "overflows max_chunks", 0, 64, 8, 7, FAILURE, { { 0 } } },
+	{ "page below 8", 0, 16, 4, CHECK_MAX_CHUNKS, FAILURE, { { 0 } } },
+	{ "page above 128", 0, 16, 256, CHECK_MAX_CHUNKS, FAILURE, { { 0 } } },
+	{ "nothing to write", 40, 0, 32, CHECK_MAX_CHUNKS, 0, { { 0 } } },
+};
+
+/* checks one case, chunks must match and point into buffer at their offset */
+static int check_plan(const PLAN_CASE *check, uint8_t *buffer)
+{
+	I2C_SEGMENT chunks[CHECK_MAX_CHUNKS];
+	int count;
+	int i;
+
+	count = i2c_plan_write(check->offset, check->length, check->page_size, &buffer[check->offset],
+		chunks, check->max_chunks);
+
+	if (count != check->count) {
+		printf("i2c_plan_write %s: %d chunks, expected %d\n", check->name, count, check->count);
+		return FAILURE;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (chunks[i].offset != check->chunk[i][0] || chunks[i].length != check->chunk[i][1] ||
+			chunks[i].buffer != &buffer[chunks[i].offset]) {
+			printf("i2c_plan_write %s: chunk %d is %d+%d, expected %d+%d\n", check->name, i,
+				chunks[i].offset, chunks[i].length, check->chunk[i][0], check->chunk[i][1]);
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
+
+int main(void)
+{
+	uint8_t buffer[CHECK_BUFFER_LEN];
+	int failed = 0;
+	int i;
+
+	for (i = 0; i < (int)(sizeof(PLAN_CASES) / sizeof(PLAN_CASES[0])); i++) {
+		if (check_plan(&PLAN_CASES[i], buffer) != SUCCESS)
+			failed++;
+	}
+
+	printf("ocs-fru-check: %d cases, %d failed\n", i, failed);
+
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "i2clib.h"
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "ocslog.h"
+
+/* submissions waiting for one bus, run in order by its worker */
+typedef struct async_bus
+{
+	pthread_t		thread;
+	pthread_cond_t	ready;
+	I2C_REQUEST		*queue[I2C_ASYNC_QUEUE];
+	uint16_t		head;
+	uint16_t		count;
+} ASYNC_BUS;
+
+/*
+one lock guards the bus queues and the completion ring.  requests
+without a callback are counted from submit until reaped, and submit
+refuses more than the ring holds, so a worker never waits for room.
+*/
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_completed = PTHREAD_COND_INITIALIZER;
+static ASYNC_BUS *async_buses[I2C_MAX_BUSES];
+static I2C_REQUEST *async_ring[I2C_ASYNC_RING];
+static uint16_t async_ring_head = 0;
+static uint16_t async_ring_count = 0;
+static uint16_t async_outstanding = 0;
+static int async_event = -1;
+static uint8_t async_stopping = 0;
+
+/* runs one request on the pooled handle of its bus */
+static int async_execute(I2C_REQUEST *request) {
+
+	uint8_t address[I2C_ADDR_LEN];
+	int32_t handle;
+	int rc = SUCCESS;
+	uint16_t i;
+
+	if (open_i2c_channel(request->channel, &handle) != SUCCESS)
+		return FAILURE;
+
+	if (request->op == I2C_OP_READ) {
+		rc = i2c_block_read_segments(handle, request->dev_addr, request->count, request->segments);
+	}
+	else {
+		for (i = 0; i < request->count && rc == SUCCESS; i++) {
+			/* eeprom word address is sent msb first */
+			address[0] = (uint8_t)(request->segments[i].offset >> 8);
+			address[1] = (uint8_t)(request->segments[i].offset & 0xFF);
+
+			rc = i2c_block_write(handle, request->dev_addr, I2C_ADDR_LEN, address,
+				request->segments[i].length, request->segments[i].buffer);
+		}
+	}
+
+	close_i2c_channel(handle);
+
+	return rc;
+}
+
+/* puts a finished request on the completion ring, under async_lock */
+static void async_complete(I2C_REQUEST *request) {
+
+	uint64_t one = 1;
+
+	async_ring[(async_ring_head + async_ring_count) % I2C_ASYNC_RING] = request;
+	async_ring_count++;
+
+	if (async_event >= 0 && write(async_event, &one, sizeof(one)) != sizeof(one))
+		log_fnc_err(UNKNOWN_ERROR, "i2c async: completion event lost");
+
+	pthread_cond_broadcast(&async_completed);
+}
+
+/* drains the queue of one bus in submission order */
+static void *async_worker(void *arg) {
+
+	ASYNC_BUS *bus = (ASYNC_BUS *)arg;
+	I2C_REQUEST *request;
+
+	pthread_mutex_lock(&async_lock);
+
+	while (1) {
+		while (bus->count == 0 && !async_stopping)
+			pthread_cond_wait(&bus->ready, &async_lock);
+
+		/* queued requests still run after a shutdown starts */
+		if (bus->count == 0)
+			break;
+
+		request = bus->queue[bus->head];
+		bus->head = (bus->head + 1) % I2C_ASYNC_QUEUE;
+		bus->count--;
+
+		pthread_mutex_unlock(&async_lock);
+
+		request->result = async_execute(request);
+
+		if (request->callback != NULL) {
+			request->callback(request);
+			pthread_mutex_lock(&async_lock);
+		}
+		else {
+			pthread_mutex_lock(&async_lock);
+			async_complete(request);
+		}
+	}
+
+	pthread_mutex_unlock(&async_lock);
+
+	return NULL;
+}
+
+/* the worker of a bus, started on first use, under async_lock */
+static ASYNC_BUS *async_bus(uint8_t channel) {
+
+	ASYNC_BUS *bus = async_buses[channel];
+
+	if (bus != NULL)
+		return bus;
+
+	if (async_event < 0 && (async_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c async: cannot create completion event");
+		return NULL;
+	}
+
+	if ((bus = calloc(1, sizeof(ASYNC_BUS))) == NULL)
+		return NULL;
+
+	pthread_cond_init(&bus->ready, NULL);
+
+	if (pthread_create(&bus->thread, NULL, async_worker, bus) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c async: cannot start worker for bus %d", channel);
+		pthread_cond_destroy(&bus->ready);
+		free(bus);
+		return NULL;
+	}
+
+	async_buses[channel] = bus;
+
+	return bus;
+}
+
+/*
+queues a request on the worker of its bus and returns at once.  the
+request and its segments belong to the library until it completes:
+a request with a callback is handed to it on the bus worker, any
+other is returned by i2c_async_reap.  fails with errno EAGAIN when
+the bus queue or the completion ring is full.
+*/
+int i2c_async_submit(I2C_REQUEST *request) {
+
+	ASYNC_BUS *bus;
+	int rc = FAILURE;
+
+	if (request == NULL || (request->count > 0 && request->segments == NULL) ||
+		(request->op != I2C_OP_READ && request->op != I2C_OP_WRITE)) {
+		errno = EINVAL;
+		return FAILURE;
+	}
+
+	pthread_mutex_lock(&async_lock);
+
+	if (async_stopping) {
+		errno = ESHUTDOWN;
+	}
+	else if ((bus = async_bus(request->channel)) == NULL) {
+		errno = ENOMEM;
+	}
+	else if (bus->count == I2C_ASYNC_QUEUE ||
+		(request->callback == NULL && async_outstanding == I2C_ASYNC_RING)) {
+		errno = EAGAIN;
+	}
+	else {
+		request->result = FAILURE;
+		bus->queue[(bus->head + bus->count) % I2C_ASYNC_QUEUE] = request;
+		bus->count++;
+
+		if (request->callback == NULL)
+			async_outstanding++;
+
+		pthread_cond_signal(&bus->ready);
+		rc = SUCCESS;
+	}
+
+	pthread_mutex_unlock(&async_lock);
+
+	return rc;
+}
+
+/*
+takes up to max completed requests, oldest first.  waits up to
+timeout_ms for the first one: 0 only polls, a negative timeout waits
+for ever.  returns the number taken.
+*/
+int i2c_async_reap(I2C_REQUEST **completed, uint16_t max, int32_t timeout_ms) {
+
+	struct timespec deadline;
+	uint64_t events;
+	uint16_t count = 0;
+
+	if (timeout_ms > 0) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeout_ms / 1000;
+		deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&async_lock);
+
+	while (async_ring_count == 0 && async_outstanding > 0 && timeout_ms != 0) {
+		if (timeout_ms < 0)
+			pthread_cond_wait(&async_completed, &async_lock);
+		else if (pthread_cond_timedwait(&async_completed, &async_lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	while (count < max && async_ring_count > 0) {
+		completed[count++] = async_ring[async_ring_head];
+		async_ring_head = (async_ring_head + 1) % I2C_ASYNC_RING;
+		async_ring_count--;
+		async_outstanding--;
+	}
+
+	/* the event stays readable while completions wait */
+	if (async_ring_count == 0 && async_event >= 0 && read(async_event, &events, sizeof(events)) < 0 &&
+		errno != EAGAIN)
+		log_fnc_err(UNKNOWN_ERROR, "i2c async: cannot clear completion event");
+
+	pthread_mutex_unlock(&async_lock);
+
+	return count;
+}
+
+/*
+an eventfd that is readable while completions wait to be reaped, for
+poll or epoll in an event loop.  FAILURE before the first submit.
+*/
+int i2c_async_fd(void) {
+
+	int fd;
+
+	pthread_mutex_lock(&async_lock);
+	fd = async_event >= 0 ? async_event : FAILURE;
+	pthread_mutex_unlock(&async_lock);
+
+	return fd;
+}
+
+/*
+runs every queued request, then stops the bus workers.  completions
+not yet reaped are dropped.  submit works again afterwards.
+*/
+void i2c_async_shutdown(void) {
+
+	ASYNC_BUS *bus;
+	uint16_t i;
+
+	pthread_mutex_lock(&async_lock);
+	async_stopping = 1;
+	for (i = 0; i < I2C_MAX_BUSES; i++)
+		if (async_buses[i] != NULL)
+			pthread_cond_signal(&async_buses[i]->ready);
+	pthread_mutex_unlock(&async_lock);
+
+	for (i = 0; i < I2C_MAX_BUSES; i++) {
+		if ((bus = async_buses[i]) == NULL)
+			continue;
+
+		pthread_join(bus->thread, NULL);
+		pthread_cond_destroy(&bus->ready);
+		free(bus);
+		async_buses[i] = NULL;
+	}
+
+	pthread_mutex_lock(&async_lock);
+
+	if (async_event >= 0)
+		close(async_event);
+
+	async_event = -1;
+	async_ring_head = 0;
+	async_ring_count = 0;
+	async_outstanding = 0;
+	async_stopping = 0;
+
+	pthread_mutex_unlock(&async_lock);
+}
@@ -6,19 +6,429 @@
 // of the License, or (at your option) any later version.
 
 #include "i2clib.h"
+#include "i2csim.h"
+#include "i2cstats.h"
+#include "i2cretry.h"
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
 #include <stdio.h>
 #include <unistd.h>
 #include "ocslog.h"
+
+/* each read segment costs an address write and a data read message */
+#define SEGMENT_MSGS		2
+#define MAX_BATCH_SEGMENTS	(I2C_RDWR_IOCTL_MAX_MSGS / SEGMENT_MSGS)
+
+#define NO_CHANNEL			0xFF
+#define NO_HANDLE			-1
+
+/* smbus commands each fallback method needs, with two byte word addresses */
+#define SMBUS_BLOCK_FUNCS	(I2C_FUNC_SMBUS_WRITE_I2C_BLOCK | I2C_FUNC_SMBUS_WRITE_BYTE_DATA | I2C_FUNC_SMBUS_READ_BYTE)
+#define SMBUS_BYTE_FUNCS	(I2C_FUNC_SMBUS_WRITE_WORD_DATA | I2C_FUNC_SMBUS_WRITE_BYTE_DATA | I2C_FUNC_SMBUS_READ_BYTE)
+
+/*
+one configured descriptor per bus, kept open for the life of the
+process.  open_i2c_channel takes the bus lock and close_i2c_channel
+gives it back, so one thread uses a bus at a time.  the lock is
+recursive: a nested open by the holder returns the same handle.
+*/
+typedef struct i2c_pool_entry
+{
+	pthread_mutex_t		lock;
+	int32_t				handle;		/* NO_HANDLE until opened */
+	uint16_t			users;		/* opens not yet closed, by the holder */
+	uint8_t				stale;		/* closed and reopened once released */
+	uint8_t				probed;		/* profile is valid, kept across reopens */
+	I2C_PROFILE			profile;
+} I2C_POOL_ENTRY;
+
+static I2C_POOL_ENTRY handle_pool[I2C_MAX_BUSES];
+static pthread_once_t handle_pool_once = PTHREAD_ONCE_INIT;
+
+/* handles outside the pool keep the fixed sizes used before probing */
+static I2C_PROFILE default_profile = { I2C_FUNC_I2C, I2C_METHOD_RDWR, I2C_MIN_READ_LEN, I2C_MAX_PAGE_SIZE };
+
+/* ack polling bound, 0 always uses the fixed write cycle wait */
+static uint32_t ack_poll_us = I2C_ACK_POLL_US;
+
+static I2C_WRITE_STATS write_stats[I2C_MAX_DEVICES];
+static uint16_t write_stats_count = 0;
+static pthread_mutex_t write_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t channel_of(int32_t handle);
+static void init_handle_pool(void);
+
+/* true for errors of the addressed device rather than the adapter */
+static int device_error(int error) {
+
+	return error == EREMOTEIO || error == ENXIO || error == EIO || error == EAGAIN || error == ETIMEDOUT;
+}
+
+/* a broken descriptor is reopened, the caller holds the bus */
+static void adapter_failed(int32_t handle) {
+
+	uint8_t channel = channel_of(handle);
+
+	/* refused messages leave the descriptor usable */
+	if (!device_error(errno) && errno != EOPNOTSUPP && channel != NO_CHANNEL &&
+		handle_pool[channel].handle == handle)
+		handle_pool[channel].stale = 1;
+}
+
+/* issues a combined transaction to the adapter, or the simulator */
+static int i2c_transfer(int32_t handle, struct i2c_msg *msgs, uint32_t nmsgs) {
+
+	struct i2c_rdwr_ioctl_data msgst;
+
+	if (i2c_sim_enabled())
+		return i2c_sim_transfer(channel_of(handle), msgs, nmsgs);
+
+	msgst.msgs = msgs;
+	msgst.nmsgs = nmsgs;
+
+	if (ioctl(handle, I2C_RDWR, &msgst) < SUCCESS) {
+		adapter_failed(handle);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/*
+issues one smbus command.  the address is forced like I2C_RDWR does,
+so a kernel driver bound to the eeprom does not lock us out.
+*/
+static int smbus_transfer(int32_t handle, uint8_t dev_addr, uint8_t read_write, uint8_t command,
+	uint32_t size, union i2c_smbus_data *data) {
+
+	struct i2c_smbus_ioctl_data args;
+
+	args.read_write = read_write;
+	args.command = command;
+	args.size = size;
+	args.data = data;
+
+	if (i2c_sim_enabled())
+		return i2c_sim_smbus(channel_of(handle), dev_addr, &args);
+
+	if (ioctl(handle, I2C_SLAVE_FORCE, dev_addr) < SUCCESS || ioctl(handle, I2C_SMBUS, &args) < SUCCESS) {
+		adapter_failed(handle);
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+/* profile of the bus behind a handle, the caller holds the bus */
+static I2C_PROFILE *profile_of(int32_t handle) {
+
+	uint8_t channel = channel_of(handle);
+
+	if (channel == NO_CHANNEL || handle_pool[channel].handle != handle || !handle_pool[channel].probed)
+		return &default_profile;
+
+	return &handle_pool[channel].profile;
+}
+
+/*
+asks the adapter what it can do and picks the best method: combined
+i2c messages, then smbus block writes, then smbus byte writes.  reads
+start at I2C_MAX_READ_LEN and shrink while the adapter refuses them.
+*/
+static void probe_adapter(uint8_t channel, int32_t handle, I2C_PROFILE *profile) {
+
+	unsigned long funcs = 0;
+
+	if (i2c_sim_enabled()) {
+		funcs = i2c_sim_funcs();
+	}
+	else if (ioctl(handle, I2C_FUNCS, &funcs) < SUCCESS) {
+		log_info("i2c bus %d: I2C_FUNCS failed, assuming plain i2c", channel);
+		funcs = I2C_FUNC_I2C;
+	}
+
+	profile->funcs = (uint32_t)funcs;
+	profile->max_read = I2C_MAX_READ_LEN;
+
+	if (funcs & I2C_FUNC_I2C) {
+		profile->method = I2C_METHOD_RDWR;
+		profile->max_write = I2C_MAX_PAGE_SIZE;
+	}
+	else if ((funcs & SMBUS_BLOCK_FUNCS) == SMBUS_BLOCK_FUNCS) {
+		/* the block carries the low address byte ahead of the data */
+		profile->method = I2C_METHOD_SMBUS_BLOCK;
+		profile->max_write = I2C_SMBUS_BLOCK_MAX - 1;
+	}
+	else if ((funcs & SMBUS_BYTE_FUNCS) == SMBUS_BYTE_FUNCS) {
+		profile->method = I2C_METHOD_SMBUS_BYTE;
+		profile->max_write = 1;
+	}
+	else {
+		log_fnc_err(UNKNOWN_ERROR, "i2c bus %d: no supported transfer method (funcs %08lx)", channel, funcs);
+		memcpy(profile, &default_profile, sizeof(I2C_PROFILE));
+		profile->funcs = (uint32_t)funcs;
+	}
+}
+
+/*
+sets the eeprom word address, which is also the probe for the end of
+a write cycle.  write_buf holds write_length address bytes, msb first.
+*/
+static int set_address(int32_t handle, uint8_t dev_addr, uint16_t write_length, uint8_t *write_buf) {
+
+	union i2c_smbus_data data;
+	struct i2c_msg msg;
+
+	if (profile_of(handle)->method == I2C_METHOD_RDWR) {
+		msg.addr = dev_addr;
+		msg.flags = 0;
+		msg.len = write_length;
+		msg.buf = write_buf;
+
+		return i2c_transfer(handle, &msg, 1);
+	}
+
+	if (write_length == 1)
+		return smbus_transfer(handle, dev_addr, I2C_SMBUS_WRITE, write_buf[0], I2C_SMBUS_BYTE, NULL);
+
+	data.byte = write_buf[1];
+
+	return smbus_transfer(handle, dev_addr, I2C_SMBUS_WRITE, write_buf[0], I2C_SMBUS_BYTE_DATA, &data);
+}
+
+/* smbus read: set the address, then sequential single byte reads */
+static int smbus_read(int32_t handle, uint8_t dev_addr, uint16_t write_length, uint8_t *write_buf,
+	uint16_t length, uint8_t *buffer) {
+
+	union i2c_smbus_data data;
+	uint16_t i;
+
+	if (set_address(handle, dev_addr, write_length, write_buf) != SUCCESS)
+		return FAILURE;
+
+	for (i = 0; i < length; i++) {
+		if (smbus_transfer(handle, dev_addr, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data) != SUCCESS)
+			return FAILURE;
+		buffer[i] = data.byte;
+	}
+
+	return SUCCESS;
+}
+
+static uint32_t elapsed_us(struct timespec *start) {
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint32_t)(((now.tv_sec - start->tv_sec) * 1000000) +
+		((now.tv_nsec - start->tv_nsec) / 1000));
+}
+
+/*
+bus of a pooled handle, found in the pool itself so any descriptor
+number works.  an entry drops its handle before closing it, so a
+number reused by another bus is never matched twice.
+*/
+static uint8_t channel_of(int32_t handle) {
+
+	uint16_t i;
+
+	if (handle < 0)
+		return NO_CHANNEL;
+
+	pthread_once(&handle_pool_once, init_handle_pool);
+
+	for (i = 0; i < I2C_MAX_BUSES; i++) {
+		if (handle_pool[i].handle == handle)
+			return (uint8_t)i;
+	}
+
+	return NO_CHANNEL;
+}
+
+/*
+adds a finished transaction to the shared statistics, then decides
+whether to repeat it.  when the error class has retries left this
+backs off and returns 1, errno is kept for the caller either way.
+*/
+static int retry_transaction(int32_t handle, uint8_t dev_addr, uint32_t bytes, struct timespec *start,
+	int rc, uint16_t attempt) {
+
+	uint8_t channel = channel_of(handle);
+	int error = errno;
+
+	if (channel != NO_CHANNEL)
+		i2c_stats_record(channel, dev_addr, bytes, elapsed_us(start), rc == SUCCESS ? 0 : error);
+
+	if (rc == SUCCESS || !i2c_retry_wait(attempt, error)) {
+		errno = error;
+		return 0;
+	}
+
+	log_info("i2c bus %d device %02x: retry %d after errno %d", channel, dev_addr, attempt + 1, error);
+
+	if (channel != NO_CHANNEL)
+		i2c_stats_retry(channel, dev_addr);
+
+	return 1;
+}
+
+/* adds one completed write cycle to the statistics of its device */
+static void record_write_cycle(int32_t handle, uint8_t dev_addr, uint32_t cycle_us, uint32_t polls, uint8_t fallback) {
+
+	I2C_WRITE_STATS *stats = NULL;
+	uint8_t channel = channel_of(handle);
+	uint16_t i;
+
+	pthread_mutex_lock(&write_stats_lock);
+
+	for (i = 0; i < write_stats_count; i++) {
+		if (write_stats[i].channel == channel && write_stats[i].dev_addr == dev_addr) {
+			stats = &write_stats[i];
+			break;
+		}
+	}
+
+	if (stats == NULL && write_stats_count < I2C_MAX_DEVICES) {
+		stats = &write_stats[write_stats_count++];
+		memset(stats, 0, sizeof(I2C_WRITE_STATS));
+		stats->channel = channel;
+		stats->dev_addr = dev_addr;
+		stats->min_us = UINT32_MAX;
+	}
+
+	if (stats != NULL) {
+		stats->writes++;
+		stats->polls += polls;
+		stats->fallbacks += fallback;
+		stats->total_us += cycle_us;
+		if (cycle_us < stats->min_us)
+			stats->min_us = cycle_us;
+		if (cycle_us > stats->max_us)
+			stats->max_us = cycle_us;
+	}
+
+	pthread_mutex_unlock(&write_stats_lock);
+}
+
+/*
+waits for the internal write cycle to finish.  the device does not
+acknowledge its address while busy, so address only writes are sent
+until one is acknowledged or the bound expires.  adapters that reject
+the probe fall back to the fixed wait.  a timed out probe is retried
+by the timeout policy, any other failure is the bus and fails the
+write with its errno.
+*/
+static int wait_write_cycle(int32_t handle, uint8_t dev_addr, uint16_t write_length, uint8_t *write_buf) {
+
+	struct timespec start;
+	uint32_t polls = 0;
+	uint32_t cycle_us = 0;
+	uint16_t timeouts = 0;
+	int error;
+	int class;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (ack_poll_us == 0) {
+		usleep(I2C_WRITE_CYCLE_US);
+		record_write_cycle(handle, dev_addr, elapsed_us(&start), 0, 1);
+		return SUCCESS;
+	}
+
+	while (1) {
+		polls++;
+
+		if (set_address(handle, dev_addr, write_length, write_buf) == SUCCESS)
+			break;
+
+		error = errno;
+
+		/* the adapter rejects address only writes */
+		if (error == EOPNOTSUPP || error == EINVAL) {
+			usleep(I2C_WRITE_CYCLE_US);
+			record_write_cycle(handle, dev_addr, elapsed_us(&start), polls, 1);
+			return SUCCESS;
+		}
+
+		/* nak while the write cycle runs, a timeout is a stuck bus */
+		class = i2c_retry_class(error);
+		if (class == I2C_RETRY_TIMEOUT && i2c_retry_wait(timeouts++, error))
+			continue;
+
+		if (class != I2C_RETRY_NAK && class != I2C_RETRY_ARBITRATION) {
+			log_fnc_err(UNKNOWN_ERROR, "device (%02x) write cycle poll failed (%d)", dev_addr, error);
+			errno = error;
+			return FAILURE;
+		}
+
+		if (elapsed_us(&start) >= ack_poll_us) {
+			log_fnc_err(UNKNOWN_ERROR, "device (%02x) busy after %d us write cycle", dev_addr, ack_poll_us);
+			return FAILURE;
+		}
+
+		usleep(I2C_ACK_POLL_GAP_US);
+	}
+
+	cycle_us = elapsed_us(&start);
+	record_write_cycle(handle, dev_addr, cycle_us, polls, 0);
+
+	return SUCCESS;
+}
+
+/* sets the ack polling bound in microseconds, 0 selects the fixed wait */
+void i2c_set_ack_poll(uint32_t timeout_us) {
+
+	ack_poll_us = timeout_us;
+}
+
+/* copies the write cycle statistics of every device written so far */
+int i2c_get_write_stats(I2C_WRITE_STATS *stats, uint16_t max_stats) {
+
+	uint16_t count;
+
+	pthread_mutex_lock(&write_stats_lock);
+
+	count = write_stats_count < max_stats ? write_stats_count : max_stats;
+	memcpy(stats, write_stats, count * sizeof(I2C_WRITE_STATS));
+
+	pthread_mutex_unlock(&write_stats_lock);
+
+	return count;
+}
 
-int open_i2c_channel(uint8_t channel, int32_t *handle) {
+static void init_handle_pool(void) {
+
+	pthread_mutexattr_t attr;
+	uint16_t i;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+
+	for (i = 0; i < I2C_MAX_BUSES; i++) {
+		pthread_mutex_init(&handle_pool[i].lock, &attr);
+		handle_pool[i].handle = NO_HANDLE;
+	}
+
+	pthread_mutexattr_destroy(&attr);
+}
+
+/* opens and configures the device file of a bus */
+static int open_device(uint8_t channel, int32_t *handle) {
 
 	char filename[20];
 	sprintf(filename, I2C_DEV_FILE, channel);
 
+	if (i2c_sim_enabled()) {
+		return i2c_sim_open(handle);
+	}
+
 	*handle = open(filename, O_RDWR);
 	if (*handle < SUCCESS)
 	{
@@ -26,13 +436,15 @@ int open_i2c_channel(uint8_t channel, int32_t *handle) {
 		return FAILURE;
 	}
 
+	/* arbitration is retried here with a backoff, not blindly in the kernel */
 	ioctl(*handle, I2C_TIMEOUT, 3);
-	ioctl(*handle, I2C_RETRIES, 3);
+	ioctl(*handle, I2C_RETRIES, 0);
 
 	return SUCCESS;
 }
 
-int close_i2c_channel(int32_t handle) {
+static int close_device(int32_t handle) {
+
 	if(close(handle) != SUCCESS){
 		log_fnc_err(UNKNOWN_ERROR, "error closing i2c file handle");
 		return FAILURE;
@@ -41,26 +453,193 @@ int close_i2c_channel(int32_t handle) {
 	return SUCCESS;
 }
 
+/*
+takes the pooled handle of a bus, opening it on first use or after an
+adapter error.  blocks while another thread holds the bus.
+*/
+int open_i2c_channel(uint8_t channel, int32_t *handle) {
+
+	I2C_POOL_ENTRY *entry = &handle_pool[channel];
+	int32_t stale;
+	int32_t opened;
+
+	pthread_once(&handle_pool_once, init_handle_pool);
+	pthread_mutex_lock(&entry->lock);
+
+	if (entry->handle != NO_HANDLE && entry->stale && entry->users == 0) {
+		stale = entry->handle;
+		entry->handle = NO_HANDLE;
+		close_device(stale);
+	}
+
+	if (entry->handle == NO_HANDLE) {
+		if (open_device(channel, &opened) != SUCCESS) {
+			pthread_mutex_unlock(&entry->lock);
+			return FAILURE;
+		}
+		entry->handle = opened;
+		entry->stale = 0;
+
+		if (!entry->probed) {
+			probe_adapter(channel, entry->handle, &entry->profile);
+			entry->probed = 1;
+		}
+	}
+
+	entry->users++;
+	*handle = entry->handle;
+
+	return SUCCESS;
+}
+
+/* gives a pooled handle back, it stays open unless it went stale */
+int close_i2c_channel(int32_t handle) {
+
+	uint8_t channel = channel_of(handle);
+	I2C_POOL_ENTRY *entry;
+	int rc = SUCCESS;
+
+	/* not a pooled handle */
+	if (channel == NO_CHANNEL)
+		return close_device(handle);
+
+	entry = &handle_pool[channel];
+
+	/* only the holder gives the bus back, the recursive lock tells */
+	if (pthread_mutex_trylock(&entry->lock) != SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c handle %d closed by a thread not holding it", handle);
+		return FAILURE;
+	}
+
+	if (entry->users == 0) {
+		pthread_mutex_unlock(&entry->lock);
+		log_fnc_err(UNKNOWN_ERROR, "i2c handle %d closed twice", handle);
+		return FAILURE;
+	}
+
+	if (--entry->users == 0 && entry->stale) {
+		entry->handle = NO_HANDLE;
+		rc = close_device(handle);
+	}
+
+	/* once for the trylock, once for the open */
+	pthread_mutex_unlock(&entry->lock);
+	pthread_mutex_unlock(&entry->lock);
+
+	return rc;
+}
+
+/* copies the profile of a bus, FAILURE until the bus has been opened */
+int i2c_get_profile(uint8_t channel, I2C_PROFILE *profile) {
+
+	I2C_POOL_ENTRY *entry = &handle_pool[channel];
+	int rc = FAILURE;
+
+	pthread_once(&handle_pool_once, init_handle_pool);
+	pthread_mutex_lock(&entry->lock);
+
+	if (entry->probed) {
+		memcpy(profile, &entry->profile, sizeof(I2C_PROFILE));
+		rc = SUCCESS;
+	}
+
+	pthread_mutex_unlock(&entry->lock);
+
+	return rc;
+}
+
+/*
+smbus page write, split into the pieces one command carries.  each
+piece is a complete eeprom write with its own write cycle.
+*/
+static int smbus_write(int32_t handle, uint8_t dev_addr, uint16_t write_length, uint8_t *write_buf,
+	uint16_t length, uint8_t *buffer) {
+
+	I2C_PROFILE *profile = profile_of(handle);
+	union i2c_smbus_data data;
+	uint8_t address[I2C_ADDR_LEN];
+	uint16_t offset;
+	uint16_t piece;
+	uint16_t done = 0;
+	uint8_t command;
+	uint32_t size;
+	struct timespec start;
+	uint16_t attempt;
+	int rc;
+
+	offset = write_length == I2C_ADDR_LEN ? (uint16_t)(write_buf[0] << 8 | write_buf[1]) : write_buf[0];
+
+	while (done < length) {
+		piece = length - done;
+		if (piece > profile->max_write)
+			piece = profile->max_write;
+
+		address[0] = (uint8_t)(offset >> 8);
+		address[1] = (uint8_t)(offset & 0xFF);
+
+		/* a one byte address is the command, a two byte one spills into the data */
+		command = write_length == I2C_ADDR_LEN ? address[0] : address[1];
+
+		if (profile->method == I2C_METHOD_SMBUS_BLOCK) {
+			size = I2C_SMBUS_I2C_BLOCK_DATA;
+			data.block[0] = (uint8_t)(piece + write_length - 1);
+			data.block[1] = address[1];
+			memcpy(&data.block[write_length], &buffer[done], piece);
+		}
+		else if (write_length == I2C_ADDR_LEN) {
+			size = I2C_SMBUS_WORD_DATA;
+			data.word = (uint16_t)(address[1] | buffer[done] << 8);
+		}
+		else {
+			size = I2C_SMBUS_BYTE_DATA;
+			data.byte = buffer[done];
+		}
+
+		attempt = 0;
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			rc = smbus_transfer(handle, dev_addr, I2C_SMBUS_WRITE, command, size, &data);
+		} while (retry_transaction(handle, dev_addr, piece + write_length, &start, rc, attempt++));
+
+		if (rc != SUCCESS) {
+			log_info("smbus write of %d bytes at offset %d failed", piece, offset);
+			return FAILURE;
+		}
+
+		if (wait_write_cycle(handle, dev_addr, write_length, write_length == I2C_ADDR_LEN ? address : &address[1]) != SUCCESS)
+			return FAILURE;
+
+		offset += piece;
+		done += piece;
+	}
+
+	return SUCCESS;
+}
+
 int i2c_block_write(int32_t handle, uint8_t dev_addr, uint16_t write_length, uint8_t *write_buf, uint16_t length, uint8_t *buffer) {
 
 	struct i2c_msg msg;
-	struct i2c_rdwr_ioctl_data msgst;
+	struct timespec start;
+	uint16_t attempt = 0;
+	int rc;
 
-
-	if (length + 2 > MAX_PAGE_SIZE || length > MAX_PAYLOAD_LEN) {
+	if (length > I2C_MAX_PAGE_SIZE || write_length > I2C_ADDR_LEN) {
 		log_fnc_err(UNKNOWN_ERROR, "error: block too large");
 			return FAILURE;
 	}
 
-	/* page limit of 32 bytes including address */
-	uint8_t write_buffer[MAX_PAYLOAD_LEN + 2];
+	if (profile_of(handle)->method != I2C_METHOD_RDWR)
+		return smbus_write(handle, dev_addr, write_length, write_buf, length, buffer);
+
+	/* one page of data after the word address */
+	uint8_t write_buffer[I2C_MAX_PAGE_SIZE + I2C_ADDR_LEN];
 
-	memset(&write_buffer, 0, MAX_PAYLOAD_LEN+2);
+	memset(&write_buffer, 0, sizeof(write_buffer));
 	memcpy(&write_buffer, write_buf, write_length);
 	memcpy(&write_buffer[write_length], buffer, length);
 
 	int i;
-	for(i=0;i<MAX_PAYLOAD_LEN+2;i++)
+	for(i=0;i<write_length+length;i++)
 		log_info("%02x ", write_buffer[i]);
 	log_info("\n");
 
@@ -69,24 +648,48 @@ int i2c_block_write(int32_t handle, uint8_t dev_addr, uint16_t write_length, uin
 	msg.len = (length + write_length);
 	msg.buf = write_buffer;
 
-	msgst.nmsgs = 1;
-	msgst.msgs = &msg;
+	/* a nak here is usually the write cycle of the previous page */
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		rc = i2c_transfer(handle, &msg, 1);
+	} while (retry_transaction(handle, dev_addr, msg.len, &start, rc, attempt++));
 
-	if (ioctl(handle, I2C_RDWR, &msgst) < SUCCESS) {
+	if (rc != SUCCESS) {
 		log_info("transaction failed");
 		return FAILURE;
 	}
 
-	usleep(5000);
-
-	return SUCCESS;
+	/* an address only write is a cheap probe that leaves no data */
+	return wait_write_cycle(handle, dev_addr, write_length, write_buffer);
 
 }
 
 int i2c_block_read(int32_t handle, uint8_t dev_addr, uint8_t write_len, uint8_t *write_buf, uint16_t length, uint8_t *buffer) {
 
+	I2C_PROFILE *profile = profile_of(handle);
+	I2C_SEGMENT segment;
 	struct i2c_msg msg[2];
-	struct i2c_rdwr_ioctl_data msgst;
+	struct timespec start;
+	uint16_t attempt = 0;
+	int rc;
+
+	if (profile->method != I2C_METHOD_RDWR) {
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			rc = smbus_read(handle, dev_addr, write_len, write_buf, length, buffer);
+		} while (retry_transaction(handle, dev_addr, write_len + length, &start, rc, attempt++));
+
+		return rc;
+	}
+
+	/* longer than the adapter takes, split like a segment list */
+	if (length > profile->max_read && write_len == I2C_ADDR_LEN) {
+		segment.offset = (uint16_t)(write_buf[0] << 8 | write_buf[1]);
+		segment.length = length;
+		segment.buffer = buffer;
+
+		return i2c_block_read_segments(handle, dev_addr, 1, &segment);
+	}
 
 	msg[0].addr = dev_addr;
 	msg[0].flags = 0;
@@ -98,13 +701,180 @@ int i2c_block_read(int32_t handle, uint8_t dev_addr, uint8_t write_len, uint8_t
 	msg[1].len = length;
 	msg[1].buf = buffer;
 
-	msgst.msgs = msg;
-	msgst.nmsgs = 2;
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		rc = i2c_transfer(handle, msg, 2);
+	} while (retry_transaction(handle, dev_addr, write_len + length, &start, rc, attempt++));
 
-	if (ioctl(handle, I2C_RDWR, &msgst) < SUCCESS) {
+	if (rc != SUCCESS) {
 		log_info("i2c_block_read - write/read offset failed.");
 		return FAILURE;
 	}
 
 	return SUCCESS;
 }
+
+/*
+reads a batch of runs, one address/read message pair each.  a failed
+transaction is retried on its own: the whole batch for I2C_RDWR, one
+run for smbus, never the runs already read.
+*/
+static int read_runs(int32_t handle, uint8_t dev_addr, uint16_t runs, struct i2c_msg *msg) {
+
+	struct timespec start;
+	uint16_t attempt = 0;
+	uint32_t bytes = 0;
+	int rc = SUCCESS;
+	uint16_t i;
+
+	if (profile_of(handle)->method == I2C_METHOD_RDWR) {
+		for (i = 0; i < runs * SEGMENT_MSGS; i++)
+			bytes += msg[i].len;
+
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			rc = i2c_transfer(handle, msg, runs * SEGMENT_MSGS);
+		} while (retry_transaction(handle, dev_addr, bytes, &start, rc, attempt++));
+
+		return rc;
+	}
+
+	for (i = 0; i < runs && rc == SUCCESS; i++) {
+		bytes = I2C_ADDR_LEN + msg[i * SEGMENT_MSGS + 1].len;
+		attempt = 0;
+
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			rc = smbus_read(handle, dev_addr, I2C_ADDR_LEN, msg[i * SEGMENT_MSGS].buf,
+				msg[i * SEGMENT_MSGS + 1].len, msg[i * SEGMENT_MSGS + 1].buf);
+		} while (retry_transaction(handle, dev_addr, bytes, &start, rc, attempt++));
+	}
+
+	return rc;
+}
+
+/*
+reads a list of segments from one device.  segments that continue each
+other both in the eeprom and in memory are coalesced into runs of up
+to the adapter's read size, and as many address/read message pairs as
+the kernel allows go into each I2C_RDWR.  when the adapter refuses a
+read size the bus profile is halved and the batch retried.
+*/
+int i2c_block_read_segments(int32_t handle, uint8_t dev_addr, uint16_t count, I2C_SEGMENT *segments) {
+
+	struct i2c_msg msg[MAX_BATCH_SEGMENTS * SEGMENT_MSGS];
+	uint8_t address[MAX_BATCH_SEGMENTS][I2C_ADDR_LEN];
+	I2C_PROFILE *profile = profile_of(handle);
+	uint16_t segment = 0;		/* next segment to read */
+	uint16_t used = 0;			/* bytes of it already read */
+	uint16_t batch_segment;
+	uint16_t batch_used;
+	uint16_t runs;
+	uint16_t offset;
+	uint16_t length;
+	uint16_t take;
+	uint8_t *buffer;
+
+	if (count > 0 && segments == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "error: no segment list");
+		return FAILURE;
+	}
+
+	while (segment < count) {
+
+		batch_segment = segment;
+		batch_used = used;
+
+		for (runs = 0; runs < MAX_BATCH_SEGMENTS && segment < count; runs++) {
+			offset = (uint16_t)(segments[segment].offset + used);
+			buffer = segments[segment].buffer + used;
+			length = 0;
+
+			while (segment < count && length < profile->max_read &&
+				(uint16_t)(segments[segment].offset + used) == (uint16_t)(offset + length) &&
+				segments[segment].buffer + used == buffer + length) {
+
+				take = segments[segment].length - used;
+				if (take > profile->max_read - length)
+					take = profile->max_read - length;
+
+				length += take;
+				used += take;
+
+				if (used == segments[segment].length) {
+					segment++;
+					used = 0;
+				}
+			}
+
+			/* eeprom word address is sent msb first */
+			address[runs][0] = (uint8_t)(offset >> 8);
+			address[runs][1] = (uint8_t)(offset & 0xFF);
+
+			msg[runs * SEGMENT_MSGS].addr = dev_addr;
+			msg[runs * SEGMENT_MSGS].flags = 0;
+			msg[runs * SEGMENT_MSGS].len = I2C_ADDR_LEN;
+			msg[runs * SEGMENT_MSGS].buf = address[runs];
+
+			msg[runs * SEGMENT_MSGS + 1].addr = dev_addr;
+			msg[runs * SEGMENT_MSGS + 1].flags = I2C_M_RD;
+			msg[runs * SEGMENT_MSGS + 1].len = length;
+			msg[runs * SEGMENT_MSGS + 1].buf = buffer;
+		}
+
+		if (read_runs(handle, dev_addr, runs, msg) != SUCCESS) {
+			if (errno == EOPNOTSUPP && profile->method == I2C_METHOD_RDWR &&
+				profile->max_read > I2C_MIN_READ_LEN) {
+				profile->max_read /= 2;
+				log_info("i2c adapter refused the read size, reads now %d bytes", profile->max_read);
+				i2c_stats_retry(channel_of(handle), dev_addr);
+				segment = batch_segment;
+				used = batch_used;
+				continue;
+			}
+
+			log_info("i2c_block_read_segments - read of %d runs at offset %d failed.",
+				runs, (msg[0].buf[0] << 8) | msg[0].buf[1]);
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*
+splits a write of length bytes at offset into chunks that each fill
+at most one eeprom page, so no write wraps inside a page.  returns
+the chunk count, or FAILURE when the page size is unsupported or the
+chunk list is too short.
+*/
+int i2c_plan_write(uint16_t offset, uint16_t length, uint16_t page_size, uint8_t *buffer, I2C_SEGMENT *chunks, uint16_t max_chunks) {
+
+	uint16_t count = 0;
+	uint16_t chunk = 0;
+
+	if (page_size < I2C_MIN_PAGE_SIZE || page_size > I2C_MAX_PAGE_SIZE)
+		return FAILURE;
+
+	while (length > 0) {
+
+		if (count >= max_chunks)
+			return FAILURE;
+
+		/* up to the end of the current page */
+		chunk = page_size - (offset % page_size);
+		if (chunk > length)
+			chunk = length;
+
+		chunks[count].offset = offset;
+		chunks[count].length = chunk;
+		chunks[count].buffer = buffer;
+		count++;
+
+		offset += chunk;
+		buffer += chunk;
+		length -= chunk;
+	}
+
+	return count;
+}
@@ -0,0 +1,142 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "i2cretry.h"
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "ocslog.h"
+
+#define RETRY_SPEC_LEN		128
+
+static const char *RETRY_CLASS_NAMES[I2C_RETRY_CLASSES] = { "nak", "timeout", "arbitration" };
+
+static I2C_RETRY_POLICY retry_policy[I2C_RETRY_CLASSES] = {
+	{ I2C_NAK_RETRIES, I2C_NAK_BACKOFF_US, I2C_NAK_MAX_US },
+	{ I2C_TIMEOUT_RETRIES, I2C_TIMEOUT_BACKOFF_US, I2C_TIMEOUT_MAX_US },
+	{ I2C_ARB_RETRIES, I2C_ARB_BACKOFF_US, I2C_ARB_MAX_US },
+};
+
+/* retry class of an errno, I2C_RETRY_NONE when retrying cannot help */
+int i2c_retry_class(int error) {
+
+	switch (error) {
+	case EREMOTEIO:
+	case ENXIO:
+	case EIO:
+		return I2C_RETRY_NAK;
+	case ETIMEDOUT:
+		return I2C_RETRY_TIMEOUT;
+	case EAGAIN:
+		return I2C_RETRY_ARBITRATION;
+	default:
+		return I2C_RETRY_NONE;
+	}
+}
+
+/*
+waits before the given retry of a transaction that failed with error.
+the wait doubles on every retry up to the bound of the class.  returns
+0 without waiting when the class is not retried or its retries are
+spent.
+*/
+int i2c_retry_wait(uint16_t attempt, int error) {
+
+	int error_class = i2c_retry_class(error);
+	I2C_RETRY_POLICY *policy;
+	uint32_t wait_us;
+
+	if (error_class == I2C_RETRY_NONE)
+		return 0;
+
+	policy = &retry_policy[error_class];
+	if (attempt >= policy->retries)
+		return 0;
+
+	wait_us = policy->backoff_us;
+	while (attempt-- > 0 && wait_us < policy->max_backoff_us)
+		wait_us <<= 1;
+
+	if (wait_us > policy->max_backoff_us)
+		wait_us = policy->max_backoff_us;
+
+	if (wait_us > 0)
+		usleep(wait_us);
+
+	return 1;
+}
+
+/* sets the policy of one class, a retry count of 0 turns retrying off */
+int i2c_set_retry(uint8_t error_class, I2C_RETRY_POLICY *policy) {
+
+	if (error_class >= I2C_RETRY_CLASSES || policy == NULL || policy->backoff_us > policy->max_backoff_us)
+		return FAILURE;
+
+	memcpy(&retry_policy[error_class], policy, sizeof(I2C_RETRY_POLICY));
+
+	return SUCCESS;
+}
+
+/*
+sets retry policies from a comma separated list of
+class=retries[:backoff_us[:max_backoff_us]], class one of nak,
+timeout or arbitration.  classes left out keep their policy.
+*/
+int i2c_retry_configure(const char *spec) {
+
+	I2C_RETRY_POLICY policy;
+	char buffer[RETRY_SPEC_LEN];
+	char *saveptr = NULL;
+	char *token;
+	char *value;
+	char *end;
+	uint8_t i;
+
+	if (spec == NULL || strlen(spec) >= RETRY_SPEC_LEN) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c retry: invalid configuration");
+		return FAILURE;
+	}
+
+	strcpy(buffer, spec);
+
+	for (token = strtok_r(buffer, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+
+		value = strchr(token, '=');
+		if (value == NULL) {
+			log_fnc_err(UNKNOWN_ERROR, "i2c retry: expected class=retries: %s", token);
+			return FAILURE;
+		}
+		*value++ = '\0';
+
+		for (i = 0; i < I2C_RETRY_CLASSES; i++) {
+			if (strcmp(token, RETRY_CLASS_NAMES[i]) == SUCCESS)
+				break;
+		}
+
+		if (i == I2C_RETRY_CLASSES) {
+			log_fnc_err(UNKNOWN_ERROR, "i2c retry: unknown class: %s", token);
+			return FAILURE;
+		}
+
+		memcpy(&policy, &retry_policy[i], sizeof(I2C_RETRY_POLICY));
+
+		policy.retries = (uint16_t)strtoul(value, &end, 10);
+		if (*end == ':')
+			policy.backoff_us = strtoul(end + 1, &end, 10);
+		if (*end == ':')
+			policy.max_backoff_us = strtoul(end + 1, &end, 10);
+		else if (policy.max_backoff_us < policy.backoff_us)
+			policy.max_backoff_us = policy.backoff_us;
+
+		if (end == value || *end != '\0' || i2c_set_retry(i, &policy) != SUCCESS) {
+			log_fnc_err(UNKNOWN_ERROR, "i2c retry: invalid policy: %s=%s", token, value);
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
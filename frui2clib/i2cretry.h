@@ -0,0 +1,27 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __i2cretry_h
+#define __i2cretry_h
+
+#include "i2clib.h"
+
+/* defaults: a nak covers a 5 ms write cycle, timeouts wait longer */
+#define I2C_NAK_RETRIES			6
+#define I2C_NAK_BACKOFF_US		100
+#define I2C_NAK_MAX_US			2000
+#define I2C_TIMEOUT_RETRIES		2
+#define I2C_TIMEOUT_BACKOFF_US	1000
+#define I2C_TIMEOUT_MAX_US		4000
+#define I2C_ARB_RETRIES			3
+#define I2C_ARB_BACKOFF_US		50
+#define I2C_ARB_MAX_US			400
+
+int i2c_retry_class(int error);
+int i2c_retry_wait(uint16_t attempt, int error);
+
+#endif //__i2cretry_h
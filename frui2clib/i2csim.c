@@ -0,0 +1,462 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "i2clib.h"
+#include "i2csim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "ocslog.h"
+
+#define SIM_SPEC_LEN		512
+
+/* one simulated eeprom */
+typedef struct i2c_sim_device
+{
+	uint8_t			channel;
+	uint8_t			dev_addr;
+	uint32_t		pointer;		/* current word address */
+	uint64_t		busy_until;		/* end of the write cycle, monotonic us */
+	uint8_t			*memory;
+} I2C_SIM_DEVICE;
+
+static uint8_t sim_enabled = 0;
+static uint32_t sim_transactions = 0;
+static I2C_SIM_CONFIG sim_config;
+static I2C_SIM_DEVICE sim_devices[I2C_SIM_DEVICES];
+static uint16_t sim_device_count = 0;
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_us(void) {
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static void sim_path(I2C_SIM_DEVICE *device, char *path) {
+
+	snprintf(path, I2C_SIM_PATH_LEN, I2C_SIM_FILE, sim_config.dir,
+		device->channel, device->dev_addr);
+}
+
+/* loads a persisted image, a missing file leaves the device erased */
+static void sim_load(I2C_SIM_DEVICE *device) {
+
+	char path[I2C_SIM_PATH_LEN];
+	FILE *image;
+
+	if (sim_config.dir[0] == '\0')
+		return;
+
+	sim_path(device, path);
+
+	image = fopen(path, "rb");
+	if (image == NULL)
+		return;
+
+	if (fread(device->memory, 1, sim_config.size, image) == 0)
+		log_info("i2c sim: empty image %s\n", path);
+
+	fclose(image);
+}
+
+static void sim_save(I2C_SIM_DEVICE *device) {
+
+	char path[I2C_SIM_PATH_LEN];
+	FILE *image;
+
+	if (sim_config.dir[0] == '\0')
+		return;
+
+	sim_path(device, path);
+
+	image = fopen(path, "wb");
+	if (image == NULL) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c sim: cannot write image (%s).\n", path);
+		return;
+	}
+
+	fwrite(device->memory, 1, sim_config.size, image);
+	fclose(image);
+}
+
+/* finds the device behind an address, creating it on first use */
+static I2C_SIM_DEVICE *sim_device(uint8_t channel, uint8_t dev_addr) {
+
+	I2C_SIM_DEVICE *device;
+	uint16_t i;
+
+	for (i = 0; i < sim_device_count; i++) {
+		if (sim_devices[i].channel == channel && sim_devices[i].dev_addr == dev_addr)
+			return &sim_devices[i];
+	}
+
+	if (sim_device_count >= I2C_SIM_DEVICES)
+		return NULL;
+
+	device = &sim_devices[sim_device_count];
+	memset(device, 0, sizeof(I2C_SIM_DEVICE));
+
+	device->memory = malloc(sim_config.size);
+	if (device->memory == NULL)
+		return NULL;
+
+	device->channel = channel;
+	device->dev_addr = dev_addr;
+	memset(device->memory, I2C_SIM_ERASED, sim_config.size);
+	sim_load(device);
+
+	sim_device_count++;
+
+	return device;
+}
+
+/* sequential read, wrapping at the end of the device */
+static void sim_read(I2C_SIM_DEVICE *device, struct i2c_msg *msg) {
+
+	uint16_t i;
+
+	for (i = 0; i < msg->len; i++) {
+		msg->buf[i] = device->memory[device->pointer];
+		device->pointer = (device->pointer + 1) % sim_config.size;
+	}
+}
+
+/*
+sets the word address and writes any data after it.  data wraps to
+the start of the page like a real eeprom.
+*/
+static void sim_write(I2C_SIM_DEVICE *device, struct i2c_msg *msg) {
+
+	uint32_t page_start;
+	uint32_t column;
+	uint16_t i;
+
+	if (msg->len < sim_config.addr_len)
+		return;
+
+	if (sim_config.addr_len == 2)
+		device->pointer = (uint32_t)(msg->buf[0] << 8 | msg->buf[1]);
+	else
+		device->pointer = msg->buf[0];
+
+	device->pointer %= sim_config.size;
+
+	if (msg->len == sim_config.addr_len)
+		return;
+
+	page_start = device->pointer - (device->pointer % sim_config.page_size);
+	column = device->pointer - page_start;
+
+	for (i = sim_config.addr_len; i < msg->len; i++) {
+		device->memory[page_start + column] = msg->buf[i];
+		column = (column + 1) % sim_config.page_size;
+	}
+
+	device->pointer = page_start + column;
+
+	sim_save(device);
+}
+
+/* sets a numeric option, returns FAILURE on garbage */
+static int sim_value(const char *value, int base, uint32_t *result) {
+
+	char *end = NULL;
+
+	*result = strtoul(value, &end, base);
+
+	if (end == value || *end != '\0')
+		return FAILURE;
+
+	return SUCCESS;
+}
+
+static int sim_option(I2C_SIM_CONFIG *config, const char *key, const char *value) {
+
+	uint32_t number = 0;
+
+	if (strcmp(key, "dir") == SUCCESS) {
+		if (strlen(value) >= I2C_SIM_DIR_LEN)
+			return FAILURE;
+		strcpy(config->dir, value);
+		return SUCCESS;
+	}
+
+	if (sim_value(value, strcmp(key, "absent") == SUCCESS || strcmp(key, "funcs") == SUCCESS ? 16 : 10, &number) != SUCCESS)
+		return FAILURE;
+
+	if (strcmp(key, "page") == SUCCESS)
+		config->page_size = (uint16_t)number;
+	else if (strcmp(key, "addr") == SUCCESS)
+		config->addr_len = (uint8_t)number;
+	else if (strcmp(key, "size") == SUCCESS)
+		config->size = number;
+	else if (strcmp(key, "txn_us") == SUCCESS)
+		config->txn_us = number;
+	else if (strcmp(key, "byte_us") == SUCCESS)
+		config->byte_us = number;
+	else if (strcmp(key, "cycle_us") == SUCCESS)
+		config->cycle_us = number;
+	else if (strcmp(key, "absent") == SUCCESS)
+		config->absent = (uint8_t)number;
+	else if (strcmp(key, "nak_every") == SUCCESS)
+		config->nak_every = number;
+	else if (strcmp(key, "timeout_every") == SUCCESS)
+		config->timeout_every = number;
+	else if (strcmp(key, "funcs") == SUCCESS)
+		config->funcs = number;
+	else if (strcmp(key, "max_read") == SUCCESS)
+		config->max_read = (uint16_t)number;
+	else
+		return FAILURE;
+
+	return SUCCESS;
+}
+
+/*
+enables the simulated transport.  spec is "default" or a comma
+separated list of key=value: page, addr, size, txn_us, byte_us,
+cycle_us, absent (hex slave address), nak_every, timeout_every,
+funcs (hex adapter I2C_FUNCS), max_read, dir.
+*/
+int i2c_sim_configure(const char *spec) {
+
+	I2C_SIM_CONFIG config;
+	char buffer[SIM_SPEC_LEN];
+	char *saveptr = NULL;
+	char *token;
+	char *value;
+
+	if (spec == NULL || strlen(spec) >= SIM_SPEC_LEN) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c sim: invalid configuration");
+		return FAILURE;
+	}
+
+	memset(&config, 0, sizeof(I2C_SIM_CONFIG));
+	config.page_size = I2C_SIM_PAGE;
+	config.addr_len = I2C_SIM_ADDR_LEN;
+	config.size = I2C_SIM_SIZE;
+	config.txn_us = I2C_SIM_TXN_US;
+	config.byte_us = I2C_SIM_BYTE_US;
+	config.cycle_us = I2C_SIM_CYCLE_US;
+	config.funcs = I2C_SIM_FUNCS;
+
+	strcpy(buffer, spec);
+
+	for (token = strtok_r(buffer, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+
+		if (strcmp(token, "default") == SUCCESS)
+			continue;
+
+		value = strchr(token, '=');
+		if (value == NULL) {
+			log_fnc_err(UNKNOWN_ERROR, "i2c sim: expected key=value: %s", token);
+			return FAILURE;
+		}
+		*value++ = '\0';
+
+		if (sim_option(&config, token, value) != SUCCESS) {
+			log_fnc_err(UNKNOWN_ERROR, "i2c sim: invalid option: %s=%s", token, value);
+			return FAILURE;
+		}
+	}
+
+	/* geometry must describe a device that can exist */
+	if (config.page_size == 0 || config.page_size > I2C_MAX_PAGE_SIZE ||
+		(config.page_size & (config.page_size - 1)) != 0 ||
+		(config.addr_len != 1 && config.addr_len != 2) ||
+		config.size < config.page_size || config.size > I2C_SIM_MAX_SIZE ||
+		(config.size % config.page_size) != 0 ||
+		(config.addr_len == 1 && config.size > 256)) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c sim: unsupported geometry");
+		return FAILURE;
+	}
+
+	pthread_mutex_lock(&sim_lock);
+	memcpy(&sim_config, &config, sizeof(I2C_SIM_CONFIG));
+	sim_enabled = 1;
+	pthread_mutex_unlock(&sim_lock);
+
+	return SUCCESS;
+}
+
+int i2c_sim_enabled(void) {
+
+	return sim_enabled;
+}
+
+/* simulated buses still get a real descriptor so close() works */
+int i2c_sim_open(int32_t *handle) {
+
+	*handle = open("/dev/null", O_RDWR);
+	if (*handle < SUCCESS) {
+		log_fnc_err(UNKNOWN_ERROR, "i2c sim: cannot open handle");
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+uint32_t i2c_sim_funcs(void) {
+
+	return sim_config.funcs;
+}
+
+/*
+runs one combined transaction against the simulated devices and
+sleeps for its modelled bus time.  failures set errno the way the
+i2c-dev driver does: ENXIO for an absent device, EREMOTEIO for a nak,
+ETIMEDOUT for a timeout and EOPNOTSUPP for a message the adapter
+cannot send.
+*/
+static int sim_transfer(uint8_t channel, struct i2c_msg *msgs, uint32_t nmsgs) {
+
+	I2C_SIM_DEVICE *device;
+	uint64_t now = now_us();
+	uint32_t bus_us = sim_config.txn_us;
+	int error = 0;
+	uint32_t i;
+
+	/* adapter quirks refuse the transaction before it reaches the bus */
+	for (i = 0; i < nmsgs; i++) {
+		if (sim_config.max_read != 0 && (msgs[i].flags & I2C_M_RD) && msgs[i].len > sim_config.max_read) {
+			errno = EOPNOTSUPP;
+			return FAILURE;
+		}
+	}
+
+	pthread_mutex_lock(&sim_lock);
+
+	sim_transactions++;
+
+	if (sim_config.timeout_every != 0 && (sim_transactions % sim_config.timeout_every) == 0)
+		error = ETIMEDOUT;
+	else if (sim_config.nak_every != 0 && (sim_transactions % sim_config.nak_every) == 0)
+		error = EREMOTEIO;
+
+	for (i = 0; i < nmsgs && error == 0; i++) {
+
+		/* address byte */
+		bus_us += sim_config.byte_us;
+
+		if (msgs[i].addr == sim_config.absent) {
+			error = ENXIO;
+			break;
+		}
+
+		device = sim_device(channel, (uint8_t)msgs[i].addr);
+		if (device == NULL) {
+			error = ENOMEM;
+			break;
+		}
+
+		if (now < device->busy_until) {
+			error = EREMOTEIO;
+			break;
+		}
+
+		bus_us += msgs[i].len * sim_config.byte_us;
+
+		if (msgs[i].flags & I2C_M_RD) {
+			sim_read(device, &msgs[i]);
+		}
+		else {
+			sim_write(device, &msgs[i]);
+
+			/* the write cycle starts at the stop condition */
+			if (msgs[i].len > sim_config.addr_len)
+				device->busy_until = now + bus_us + sim_config.cycle_us;
+		}
+	}
+
+	pthread_mutex_unlock(&sim_lock);
+
+	if (bus_us > 0)
+		usleep(bus_us);
+
+	if (error != 0) {
+		errno = error;
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+int i2c_sim_transfer(uint8_t channel, struct i2c_msg *msgs, uint32_t nmsgs) {
+
+	if ((sim_config.funcs & I2C_FUNC_I2C) == 0) {
+		errno = EOPNOTSUPP;
+		return FAILURE;
+	}
+
+	return sim_transfer(channel, msgs, nmsgs);
+}
+
+/*
+runs one smbus command as the kernel emulates it over plain i2c
+messages.  only the commands i2clib sends are modelled.
+*/
+int i2c_sim_smbus(uint8_t channel, uint8_t dev_addr, struct i2c_smbus_ioctl_data *args) {
+
+	uint8_t buffer[I2C_SMBUS_BLOCK_MAX + 2];
+	struct i2c_msg msg;
+	uint32_t needed;
+
+	msg.addr = dev_addr;
+	msg.flags = 0;
+	msg.buf = buffer;
+	buffer[0] = args->command;
+
+	if (args->size == I2C_SMBUS_BYTE && args->read_write == I2C_SMBUS_READ) {
+		needed = I2C_FUNC_SMBUS_READ_BYTE;
+		msg.flags = I2C_M_RD;
+		msg.len = 1;
+	}
+	else if (args->size == I2C_SMBUS_BYTE) {
+		needed = I2C_FUNC_SMBUS_WRITE_BYTE;
+		msg.len = 1;
+	}
+	else if (args->size == I2C_SMBUS_BYTE_DATA && args->read_write == I2C_SMBUS_WRITE) {
+		needed = I2C_FUNC_SMBUS_WRITE_BYTE_DATA;
+		buffer[1] = args->data->byte;
+		msg.len = 2;
+	}
+	else if (args->size == I2C_SMBUS_WORD_DATA && args->read_write == I2C_SMBUS_WRITE) {
+		needed = I2C_FUNC_SMBUS_WRITE_WORD_DATA;
+		buffer[1] = (uint8_t)(args->data->word & 0xFF);
+		buffer[2] = (uint8_t)(args->data->word >> 8);
+		msg.len = 3;
+	}
+	else if (args->size == I2C_SMBUS_I2C_BLOCK_DATA && args->read_write == I2C_SMBUS_WRITE &&
+		args->data->block[0] <= I2C_SMBUS_BLOCK_MAX) {
+		needed = I2C_FUNC_SMBUS_WRITE_I2C_BLOCK;
+		memcpy(&buffer[1], &args->data->block[1], args->data->block[0]);
+		msg.len = args->data->block[0] + 1;
+	}
+	else {
+		needed = 0;
+	}
+
+	if (needed == 0 || (sim_config.funcs & needed) == 0) {
+		errno = EOPNOTSUPP;
+		return FAILURE;
+	}
+
+	if (sim_transfer(channel, &msg, 1) != SUCCESS)
+		return FAILURE;
+
+	if (msg.flags & I2C_M_RD)
+		args->data->byte = buffer[0];
+
+	return SUCCESS;
+}
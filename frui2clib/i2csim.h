@@ -0,0 +1,54 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __i2csim_h
+#define __i2csim_h
+
+#include <stdint.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/* simulated devices, one image per bus and slave address */
+#define I2C_SIM_DEVICES		16
+#define I2C_SIM_MAX_SIZE	65536
+#define I2C_SIM_ERASED		0xFF
+#define I2C_SIM_FILE		"%s/i2c-%d-%02x.bin"
+#define I2C_SIM_DIR_LEN		224
+#define I2C_SIM_PATH_LEN	256
+
+/* defaults: 32 byte pages, 2 byte address, 100 kHz bus, 3 ms write cycle */
+#define I2C_SIM_PAGE		32
+#define I2C_SIM_ADDR_LEN	2
+#define I2C_SIM_SIZE		4096
+#define I2C_SIM_TXN_US		50
+#define I2C_SIM_BYTE_US		90
+#define I2C_SIM_CYCLE_US	3000
+#define I2C_SIM_FUNCS		(I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL)
+
+/* device geometry, timing and injected faults */
+typedef struct i2c_sim_config
+{
+	uint16_t		page_size;		/* write page, writes wrap inside it */
+	uint8_t			addr_len;		/* word address bytes, 1 or 2 */
+	uint32_t		size;			/* device size, reads wrap at the end */
+	uint32_t		txn_us;			/* cost of each transaction */
+	uint32_t		byte_us;		/* cost of each byte on the bus */
+	uint32_t		cycle_us;		/* internal write cycle, nak while busy */
+	uint8_t			absent;			/* slave address that never acks, 0 for none */
+	uint32_t		nak_every;		/* nak every nth transaction, 0 for never */
+	uint32_t		timeout_every;	/* time out every nth transaction, 0 for never */
+	uint32_t		funcs;			/* adapter I2C_FUNCS flags */
+	uint16_t		max_read;		/* adapter refuses longer reads, 0 for no limit */
+	char			dir[I2C_SIM_DIR_LEN];	/* images persisted here when set */
+} I2C_SIM_CONFIG;
+
+int i2c_sim_open(int32_t *handle);
+int i2c_sim_transfer(uint8_t channel, struct i2c_msg *msgs, uint32_t nmsgs);
+int i2c_sim_smbus(uint8_t channel, uint8_t dev_addr, struct i2c_smbus_ioctl_data *args);
+uint32_t i2c_sim_funcs(void);
+
+#endif //__i2csim_h
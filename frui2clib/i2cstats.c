@@ -0,0 +1,166 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "i2cstats.h"
+#include "i2csim.h"
+#include "i2cretry.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ocslog.h"
+
+/* area of this process, NULL when it could not be mapped */
+static I2C_STATS *stats = NULL;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+
+/*
+maps the statistics area, creating it when no process has yet.  every
+process sizes it and stamps the version the same way, so it does not
+matter which one gets there first.
+*/
+I2C_STATS *i2c_stats_open(uint8_t sim) {
+
+	const char *name = sim ? I2C_STATS_SIM_AREA : I2C_STATS_AREA;
+	I2C_STATS *area;
+	struct stat status;
+	int fd;
+
+	fd = shm_open(name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	if (fd < 0) {
+		log_info("i2c stats: shm open failed (%s)", name);
+		return NULL;
+	}
+
+	/* readable by other users whatever the umask */
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+
+	if (fstat(fd, &status) != SUCCESS ||
+		(status.st_size < (off_t)sizeof(I2C_STATS) && ftruncate(fd, sizeof(I2C_STATS)) != SUCCESS)) {
+		log_info("i2c stats: shm truncate failed (%s)", name);
+		close(fd);
+		return NULL;
+	}
+
+	area = mmap(NULL, sizeof(I2C_STATS), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (area == MAP_FAILED) {
+		log_info("i2c stats: shm mmap failed (%s)", name);
+		return NULL;
+	}
+
+	__sync_bool_compare_and_swap(&area->version, 0, I2C_STATS_VERSION);
+
+	if (area->version != I2C_STATS_VERSION) {
+		log_info("i2c stats: unknown version %d (%s)", area->version, name);
+		munmap(area, sizeof(I2C_STATS));
+		return NULL;
+	}
+
+	return area;
+}
+
+static void stats_attach(void) {
+
+	stats = i2c_stats_open(i2c_sim_enabled() ? 1 : 0);
+}
+
+/* counters of one device, taking the next free slot on first use */
+static I2C_COUNTERS *device_counters(uint8_t channel, uint8_t dev_addr) {
+
+	uint32_t key = I2C_STATS_KEY(channel, dev_addr);
+	uint16_t i;
+
+	for (i = 0; i < I2C_STATS_DEVICES; i++) {
+		if (stats->device[i].key == key)
+			return &stats->device[i].counters;
+
+		/* another process may take the slot first, look at it again */
+		if (stats->device[i].key == 0) {
+			if (__sync_bool_compare_and_swap(&stats->device[i].key, 0, key) ||
+				stats->device[i].key == key)
+				return &stats->device[i].counters;
+		}
+	}
+
+	return NULL;
+}
+
+static uint8_t latency_bucket(uint32_t latency_us) {
+
+	uint8_t bucket = 0;
+
+	while (latency_us != 0 && bucket < I2C_STATS_BUCKETS - 1) {
+		latency_us >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void count(I2C_COUNTERS *counters, uint32_t bytes, uint32_t latency_us, int error) {
+
+	__sync_fetch_and_add(&counters->transactions, 1);
+	__sync_fetch_and_add(&counters->bytes, bytes);
+	__sync_fetch_and_add(&counters->latency_us, latency_us);
+	__sync_fetch_and_add(&counters->histogram[latency_bucket(latency_us)], 1);
+
+	if (error == 0)
+		return;
+
+	/* the classes the retries use, lost arbitration counts as an error */
+	switch (i2c_retry_class(error)) {
+	case I2C_RETRY_NAK:
+		__sync_fetch_and_add(&counters->naks, 1);
+		break;
+	case I2C_RETRY_TIMEOUT:
+		__sync_fetch_and_add(&counters->timeouts, 1);
+		break;
+	default:
+		__sync_fetch_and_add(&counters->errors, 1);
+		break;
+	}
+}
+
+/* adds one transaction, error is its errno or 0 when it succeeded */
+void i2c_stats_record(uint8_t channel, uint8_t dev_addr, uint32_t bytes, uint32_t latency_us, int error) {
+
+	I2C_COUNTERS *counters;
+	int saved = errno;
+
+	pthread_once(&stats_once, stats_attach);
+
+	if (stats != NULL) {
+		count(&stats->bus[channel], bytes, latency_us, error);
+
+		if ((counters = device_counters(channel, dev_addr)) != NULL)
+			count(counters, bytes, latency_us, error);
+	}
+
+	errno = saved;
+}
+
+/* counts a transaction repeated after a failure */
+void i2c_stats_retry(uint8_t channel, uint8_t dev_addr) {
+
+	I2C_COUNTERS *counters;
+	int saved = errno;
+
+	pthread_once(&stats_once, stats_attach);
+
+	if (stats != NULL) {
+		__sync_fetch_and_add(&stats->bus[channel].retries, 1);
+
+		if ((counters = device_counters(channel, dev_addr)) != NULL)
+			__sync_fetch_and_add(&counters->retries, 1);
+	}
+
+	errno = saved;
+}
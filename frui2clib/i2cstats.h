@@ -0,0 +1,57 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __i2cstats_h
+#define __i2cstats_h
+
+#include "i2clib.h"
+
+/*
+transaction statistics of every bus and device, kept in a shared
+memory area so one reader sees all processes using i2clib.  the area
+is created by the first process to record a transaction, simulated
+buses use an area of their own.
+*/
+#define I2C_STATS_AREA			"/ocsi2c_stats"
+#define I2C_STATS_SIM_AREA		"/ocsi2c_stats_sim"
+#define I2C_STATS_VERSION		1
+#define I2C_STATS_DEVICES		128
+#define I2C_STATS_BUCKETS		20	/* bucket n counts [2^(n-1), 2^n) us, the last one the rest */
+
+/* counters only grow, update them with atomic adds */
+typedef struct i2c_counters
+{
+	uint64_t		transactions;
+	uint64_t		bytes;
+	uint64_t		naks;		/* EREMOTEIO, ENXIO, EIO */
+	uint64_t		timeouts;	/* ETIMEDOUT */
+	uint64_t		errors;		/* any other failure */
+	uint64_t		retries;
+	uint64_t		latency_us;	/* total */
+	uint64_t		histogram[I2C_STATS_BUCKETS];
+} I2C_COUNTERS;
+
+typedef struct i2c_device_counters
+{
+	uint32_t		key;		/* 0 while the slot is free, see I2C_STATS_KEY */
+	I2C_COUNTERS	counters;
+} I2C_DEVICE_COUNTERS;
+
+#define I2C_STATS_KEY(channel, dev_addr)	(0x10000 | ((channel) << 8) | (dev_addr))
+
+typedef struct i2c_stats
+{
+	uint32_t			version;
+	I2C_COUNTERS		bus[I2C_MAX_BUSES];
+	I2C_DEVICE_COUNTERS	device[I2C_STATS_DEVICES];	/* taken in order, first free slot ends the list */
+} I2C_STATS;
+
+I2C_STATS *i2c_stats_open(uint8_t sim);
+void i2c_stats_record(uint8_t channel, uint8_t dev_addr, uint32_t bytes, uint32_t latency_us, int error);
+void i2c_stats_retry(uint8_t channel, uint8_t dev_addr);
+
+#endif //__i2cstats_h
@@ -0,0 +1,121 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+/*
+ocs-i2c-stats dumps the transaction statistics i2clib keeps in shared
+memory: one line per bus and per device, with latency percentiles
+taken from the log scale histograms.
+*/
+#include <stdio.h>
+#include "i2cstats.h"
+#include "ocslog.h"
+
+static void stats_usage(void)
+{
+	printf("Usage: ocs-i2c-stats [-s] [-H] [-z]\n");
+	printf("		-s		statistics of the simulated buses\n");
+	printf("		-H		print the latency histograms\n");
+	printf("		-z		clear the counters after printing them\n");
+}
+
+/* upper bound of the bucket holding the given share of transactions */
+static uint32_t percentile_us(I2C_COUNTERS *counters, uint32_t percent)
+{
+	uint64_t target = (counters->transactions * percent + 99) / 100;
+	uint64_t seen = 0;
+	uint8_t bucket;
+
+	for (bucket = 0; bucket < I2C_STATS_BUCKETS - 1; bucket++) {
+		seen += counters->histogram[bucket];
+		if (seen >= target)
+			break;
+	}
+
+	return 1u << bucket;
+}
+
+static void print_counters(const char *name, I2C_COUNTERS *counters, uint8_t histogram)
+{
+	uint8_t bucket;
+
+	printf("%s: %llu transactions, %llu bytes, %llu naks, %llu timeouts, %llu errors, %llu retries\n",
+		name, (unsigned long long)counters->transactions, (unsigned long long)counters->bytes,
+		(unsigned long long)counters->naks, (unsigned long long)counters->timeouts,
+		(unsigned long long)counters->errors, (unsigned long long)counters->retries);
+
+	printf("%s: latency avg %llu us, p50 < %u us, p90 < %u us, p99 < %u us\n", name,
+		(unsigned long long)(counters->latency_us / counters->transactions),
+		percentile_us(counters, 50), percentile_us(counters, 90), percentile_us(counters, 99));
+
+	if (!histogram)
+		return;
+
+	for (bucket = 0; bucket < I2C_STATS_BUCKETS; bucket++) {
+		if (counters->histogram[bucket] == 0)
+			continue;
+
+		if (bucket == I2C_STATS_BUCKETS - 1)
+			printf("  >= %u us: %llu\n", 1u << (bucket - 1), (unsigned long long)counters->histogram[bucket]);
+		else
+			printf("  < %u us: %llu\n", 1u << bucket, (unsigned long long)counters->histogram[bucket]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	I2C_DEVICE_COUNTERS *device;
+	I2C_STATS *stats;
+	uint8_t sim = 0;
+	uint8_t histogram = 0;
+	uint8_t clear = 0;
+	char name[32];
+	uint16_t i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == SUCCESS)
+			sim = 1;
+		else if (strcmp(argv[i], "-H") == SUCCESS)
+			histogram = 1;
+		else if (strcmp(argv[i], "-z") == SUCCESS)
+			clear = 1;
+		else {
+			stats_usage();
+			return 1;
+		}
+	}
+
+	if ((stats = i2c_stats_open(sim)) == NULL) {
+		printf("cannot open the i2c statistics area\n");
+		return 1;
+	}
+
+	for (i = 0; i < I2C_MAX_BUSES; i++) {
+		if (stats->bus[i].transactions == 0)
+			continue;
+
+		sprintf(name, "bus %d", i);
+		print_counters(name, &stats->bus[i], histogram);
+	}
+
+	for (i = 0; i < I2C_STATS_DEVICES && stats->device[i].key != 0; i++) {
+		device = &stats->device[i];
+		if (device->counters.transactions == 0)
+			continue;
+
+		sprintf(name, "bus %d device %02x", (device->key >> 8) & 0xFF, device->key & 0xFF);
+		print_counters(name, &device->counters, histogram);
+	}
+
+	/* slots stay taken, devices keep their place in the list */
+	if (clear) {
+		memset(stats->bus, 0, sizeof(stats->bus));
+		for (i = 0; i < I2C_STATS_DEVICES; i++)
+			memset(&stats->device[i].counters, 0, sizeof(I2C_COUNTERS));
+	}
+
+	return 0;
+}
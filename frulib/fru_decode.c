@@ -0,0 +1,333 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <string.h>
+#include "ocsfru.h"
+#include "ocslog.h"
+
+/*
+true when the fields from idx are laid out by older ocs-fru: a zero
+byte after every field and the end marker right after the last gap.
+*/
+static uint8_t legacy_layout(uint8_t *buffer, uint16_t idx, uint16_t end)
+{
+	uint16_t gap = 0;
+
+	while (idx < end) {
+		if (buffer[idx] == FRU_AREA_STOP)
+			return 1;
+
+		gap = idx + 1 + (buffer[idx] & FRU_LENGTH_MASK);
+
+		if (gap >= end || buffer[gap] != 0)
+			return 0;
+
+		idx = gap + 1;
+	}
+
+	return 0;
+}
+
+/*
+starts a field walk of an indexed area.  fixed is the number of bytes
+between the area header and the first field, the board manufacture
+time.
+*/
+int fru_field_begin(FRU_FIELD_ITER *iter, uint8_t *buffer, const FRU_AREA *area, uint16_t fixed)
+{
+	if (iter == NULL || buffer == NULL || area == NULL)
+		return FAILURE;
+
+	/* the length is only known for indexed areas */
+	if (area->status != FRU_AREA_OK && area->status != FRU_AREA_CHKSUM)
+		return FAILURE;
+
+	memset(iter, 0, sizeof(FRU_FIELD_ITER));
+	iter->buffer = buffer;
+	iter->idx = area->offset + sizeof(AREA_HEADER) + fixed;
+	iter->end = area->offset + area->length - 1;
+
+	if (iter->idx > iter->end)
+		return FAILURE;
+
+	iter->gap = legacy_layout(buffer, iter->idx, iter->end);
+
+	return SUCCESS;
+}
+
+/*
+points field at the next type/length byte and its data.  returns
+FRU_FIELD_DONE at the end of fields marker, or at the check sum when
+the marker is missing, and FAILURE when a field runs past the area.
+*/
+int fru_field_next(FRU_FIELD_ITER *iter, AREA_FIELD *field)
+{
+	uint8_t *type_length;
+	uint16_t field_end;
+
+	if (iter->idx >= iter->end)
+		return FRU_FIELD_DONE;
+
+	type_length = &iter->buffer[iter->idx];
+
+	if (*type_length == FRU_AREA_STOP)
+		return FRU_FIELD_DONE;
+
+	field_end = iter->idx + 1 + (*type_length & FRU_LENGTH_MASK);
+
+	if (field_end > iter->end)
+		return FAILURE;
+
+	field->length = type_length;
+	field->data = type_length + 1;
+
+	/* older ocs-fru wrote 8 bit ascii with a zero type code */
+	field->type = iter->gap ? FRU_TYPE_TEXT : *type_length >> FRU_TYPE_SHIFT;
+
+	iter->idx = field_end + iter->gap;
+	iter->count++;
+
+	return SUCCESS;
+}
+
+/*
+starts a field walk of the area at area_offset through read.  only the
+area header is read, for the area length.
+*/
+int fru_field_open(FRU_FIELD_READER *reader, uint16_t area_offset, uint16_t fixed, FRU_READ_FN read, void *context)
+{
+	uint8_t header[sizeof(AREA_HEADER)];
+
+	if (reader == NULL || read == NULL || area_offset == 0)
+		return FAILURE;
+
+	memset(reader, 0, sizeof(FRU_FIELD_READER));
+	reader->read = read;
+	reader->context = context;
+	reader->ahead = -1;
+	reader->done = 1;
+
+	if (read(context, area_offset, sizeof(AREA_HEADER), header) != SUCCESS || header[1] == 0)
+		return FAILURE;
+
+	reader->next = area_offset + sizeof(AREA_HEADER) + fixed;
+	reader->end = area_offset + (header[1] * FRU_AREA_UNIT) - 1;
+	reader->done = reader->next > reader->end;
+
+	return reader->done ? FAILURE : SUCCESS;
+}
+
+/*
+reads the next type/length byte and fills loc, returns SUCCESS,
+FRU_FIELD_DONE or FAILURE as fru_field_next.  the byte after the first
+field tells the layouts apart: older ocs-fru wrote a zero there, a
+standard area the next type/length byte, which is kept.
+*/
+int fru_field_locate(FRU_FIELD_READER *reader, FRU_FIELD_LOC *loc)
+{
+	uint32_t field_end;
+	uint8_t type_length;
+	uint8_t after;
+
+	if (reader->done || reader->next >= reader->end) {
+		reader->done = 1;
+		return FRU_FIELD_DONE;
+	}
+
+	/* a failed walk cannot continue */
+	reader->done = 1;
+
+	if (reader->ahead >= 0)
+		type_length = (uint8_t)reader->ahead;
+	else if (reader->read(reader->context, (uint16_t)reader->next, 1, &type_length) != SUCCESS)
+		return FAILURE;
+
+	reader->ahead = -1;
+
+	if (type_length == FRU_AREA_STOP)
+		return FRU_FIELD_DONE;
+
+	field_end = reader->next + 1 + (type_length & FRU_LENGTH_MASK);
+
+	if (field_end > reader->end)
+		return FAILURE;
+
+	if (reader->count == 0 && field_end < reader->end) {
+		if (reader->read(reader->context, (uint16_t)field_end, 1, &after) != SUCCESS)
+			return FAILURE;
+
+		if (after == 0)
+			reader->gap = 1;
+		else
+			reader->ahead = after;
+	}
+
+	loc->offset = (uint16_t)(reader->next + 1);
+	loc->type_length = type_length;
+	loc->type = reader->gap ? FRU_TYPE_TEXT : type_length >> FRU_TYPE_SHIFT;
+
+	reader->next = field_end + reader->gap;
+	reader->count++;
+	reader->done = 0;
+
+	return SUCCESS;
+}
+
+/* reads the header of an indexed area */
+static int decode_area_header(uint8_t *buffer, const FRU_AREA *area, AREA_HEADER *header)
+{
+	/* a check sum mismatch is reported by the index, not fatal here */
+	if (area->status != FRU_AREA_OK && area->status != FRU_AREA_CHKSUM)
+		return FAILURE;
+
+	header->version = buffer[area->offset];
+	header->length = buffer[area->offset + 1];
+	header->languagecode = buffer[area->offset + 2];
+
+	return SUCCESS;
+}
+
+/*
+fills the named fields of an area in order, and keeps the fields after
+them as custom fields.  fields missing before the end marker are left
+empty.
+*/
+static int decode_fields(uint8_t *buffer, const FRU_AREA *area, uint16_t fixed,
+	AREA_FIELD **named, uint8_t named_count, AREA_FIELD *custom, uint8_t *custom_count)
+{
+	FRU_FIELD_ITER iter;
+	AREA_FIELD field;
+	int rc;
+
+	if (fru_field_begin(&iter, buffer, area, fixed) != SUCCESS)
+		return FAILURE;
+
+	while ((rc = fru_field_next(&iter, &field)) == SUCCESS) {
+		if (iter.count <= named_count)
+			*named[iter.count - 1] = field;
+		else if (*custom_count < FRU_MAX_CUSTOM)
+			custom[(*custom_count)++] = field;
+	}
+
+	return rc == FRU_FIELD_DONE ? SUCCESS : FAILURE;
+}
+
+static int decode_chassis(uint8_t *buffer, const FRU_AREA *area, FRU_CHASSIS_INFO *chassis)
+{
+	AREA_FIELD *named[] = { &chassis->part, &chassis->serial };
+
+	if (decode_area_header(buffer, area, &chassis->header) != SUCCESS)
+		return FAILURE;
+
+	/* the third header byte is the chassis type */
+	chassis->type = chassis->header.languagecode;
+	chassis->header.languagecode = 0;
+
+	return decode_fields(buffer, area, 0, named, sizeof(named) / sizeof(named[0]),
+		chassis->custom, &chassis->custom_count);
+}
+
+static int decode_board(uint8_t *buffer, const FRU_AREA *area, FRU_BOARD_INFO *board)
+{
+	AREA_FIELD *named[] = {
+		&board->manufacture, &board->name, &board->serial, &board->part, &board->fruid,
+		&board->address1, &board->address2, &board->boardver, &board->build
+	};
+
+	if (decode_area_header(buffer, area, &board->header) != SUCCESS)
+		return FAILURE;
+
+	if (sizeof(AREA_HEADER) + FRU_MFG_TIME_LEN >= area->length)
+		return FAILURE;
+
+	memcpy(board->mfgdatetime, &buffer[area->offset + sizeof(AREA_HEADER)], FRU_MFG_TIME_LEN);
+
+	return decode_fields(buffer, area, FRU_MFG_TIME_LEN, named, sizeof(named) / sizeof(named[0]),
+		board->custom, &board->custom_count);
+}
+
+static int decode_product(uint8_t *buffer, const FRU_AREA *area, FRU_PRODUCT_INFO *product)
+{
+	AREA_FIELD *named[] = {
+		&product->manufacture, &product->productname, &product->productversion, &product->serial,
+		&product->assettag, &product->fruid, &product->subproduct, &product->build
+	};
+
+	if (decode_area_header(buffer, area, &product->header) != SUCCESS)
+		return FAILURE;
+
+	return decode_fields(buffer, area, 0, named, sizeof(named) / sizeof(named[0]),
+		product->custom, &product->custom_count);
+}
+
+/*
+indexes every area of an eeprom image and decodes the chassis, board
+and product areas without copying or printing field data.
+*/
+int fru_decode(uint8_t *buffer, uint16_t length, FRU_INFO *info)
+{
+	FRU_AREA *area = NULL;
+
+	if (buffer == NULL || info == NULL)
+		return FAILURE;
+
+	memset(info, 0, sizeof(FRU_INFO));
+
+	if (length < sizeof(FRU_HEADER))
+		return FAILURE;
+
+	memcpy(&info->header, buffer, sizeof(FRU_HEADER));
+
+	if (fru_index_build(buffer, length, &info->index) != SUCCESS)
+		return FAILURE;
+
+	/* a malformed chassis area does not hide the board and product */
+	area = &info->index.area[FRU_AREA_CHASSIS];
+	if (area->status != FRU_AREA_ABSENT)
+		info->has_chassis = decode_chassis(buffer, area, &info->chassis) == SUCCESS;
+
+	area = &info->index.area[FRU_AREA_BOARD];
+	if (area->status != FRU_AREA_ABSENT) {
+		if (decode_board(buffer, area, &info->board) != SUCCESS)
+			return FAILURE;
+		info->has_board = 1;
+	}
+
+	area = &info->index.area[FRU_AREA_PRODUCT];
+	if (area->status != FRU_AREA_ABSENT) {
+		if (decode_product(buffer, area, &info->product) != SUCCESS)
+			return FAILURE;
+		info->has_product = 1;
+	}
+
+	return SUCCESS;
+}
+
+/* returns the data length of a decoded field */
+uint8_t fru_field_length(const AREA_FIELD *field)
+{
+	if (field == NULL || field->length == NULL)
+		return 0;
+
+	return *field->length & FRU_LENGTH_MASK;
+}
+
+/* returns the type code of a decoded field */
+uint8_t fru_field_type(const AREA_FIELD *field)
+{
+	if (field == NULL || field->length == NULL)
+		return 0;
+
+	return field->type;
+}
+
+/* returns the board manufacture time in minutes since 1996-01-01 */
+uint32_t fru_mfg_minutes(const FRU_BOARD_INFO *board)
+{
+	return ((uint32_t)board->mfgdatetime[2] << 16) +
+		((uint32_t)board->mfgdatetime[1] << 8) + board->mfgdatetime[0];
+}
@@ -0,0 +1,197 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <string.h>
+#include "ocsfru.h"
+#include "ocslog.h"
+
+static const char *AREA_NAMES[FRU_AREA_COUNT] = {
+	"internal", "chassis", "board", "product", "multirecord"
+};
+
+/* alternate bytes of a word, summed in 16 bit lanes */
+#define CHKSUM_LANES		0x00FF00FF00FF00FFULL
+#define CHKSUM_LANE_WORDS	128		/* words a lane holds before it can overflow */
+
+/* low byte of the sum of the four lanes */
+static uint8_t fold_lanes(uint64_t lanes)
+{
+	return (uint8_t)(lanes + (lanes >> 16) + (lanes >> 32) + (lanes >> 48));
+}
+
+/*
+calculates ones complement checksum.  whole words are summed eight
+bytes at a time, even and odd bytes in separate 16 bit lanes, and
+the tail a byte at a time.
+*/
+int calculate_chksum(uint8_t *buffer, uint16_t offset, uint16_t end_pos) {
+
+	uint8_t chksum = 0;
+	uint64_t lanes = 0;
+	uint64_t word;
+	uint16_t words = 0;
+
+	for (; offset + sizeof(uint64_t) <= end_pos; offset += sizeof(uint64_t)) {
+		memcpy(&word, &buffer[offset], sizeof(uint64_t));
+		lanes += (word & CHKSUM_LANES) + ((word >> 8) & CHKSUM_LANES);
+
+		if (++words == CHKSUM_LANE_WORDS) {
+			chksum += fold_lanes(lanes);
+			lanes = 0;
+			words = 0;
+		}
+	}
+
+	chksum += fold_lanes(lanes);
+
+	for (; offset < end_pos; offset++)
+		chksum += buffer[offset];
+
+	return (uint8_t)(~(chksum)+1);
+}
+
+int verify_chksum(uint8_t *buffer, uint16_t offset, uint16_t end_pos) {
+	return (calculate_chksum(buffer, offset, end_pos) == buffer[end_pos]) ? SUCCESS : FAILURE;
+}
+
+/* name of an area for messages and reports */
+const char *fru_area_name(uint8_t area)
+{
+	if (area >= FRU_AREA_COUNT)
+		return "unknown";
+
+	return AREA_NAMES[area];
+}
+
+/*
+fills the area offsets from the common header alone.  areas are
+marked present until fru_index_build measures them.
+*/
+void fru_index_offsets(const FRU_HEADER *header, FRU_INDEX *index)
+{
+	const uint8_t offsets[FRU_AREA_COUNT] = {
+		header->areaoffset, header->chassis, header->board,
+		header->product, header->multirecord
+	};
+	uint8_t area;
+
+	memset(index, 0, sizeof(FRU_INDEX));
+
+	index->header_status = verify_chksum((uint8_t *)header, 0, sizeof(FRU_HEADER) - 1) == SUCCESS ?
+		FRU_AREA_OK : FRU_AREA_CHKSUM;
+
+	for (area = 0; area < FRU_AREA_COUNT; area++) {
+		index->area[area].offset = offsets[area] * FRU_AREA_UNIT;
+		index->area[area].status = offsets[area] != 0 ? FRU_AREA_PRESENT : FRU_AREA_ABSENT;
+	}
+}
+
+/* chassis, board and product areas carry their length and a check sum */
+static void index_info_area(uint8_t *buffer, uint16_t length, FRU_AREA *area)
+{
+	/* areas past the end were not read and stay present */
+	if (area->status == FRU_AREA_ABSENT || area->offset >= length)
+		return;
+
+	if (area->offset + sizeof(AREA_HEADER) > length) {
+		area->status = FRU_AREA_BAD;
+		return;
+	}
+
+	area->length = buffer[area->offset + 1] * FRU_AREA_UNIT;
+
+	if (area->length == 0 || area->offset + area->length > length) {
+		area->status = FRU_AREA_BAD;
+		return;
+	}
+
+	area->status = verify_chksum(buffer, area->offset, area->offset + area->length - 1) == SUCCESS ?
+		FRU_AREA_OK : FRU_AREA_CHKSUM;
+}
+
+/* the internal use area has no length, it runs up to the next area */
+static void index_internal_area(uint16_t length, FRU_INDEX *index)
+{
+	FRU_AREA *internal = &index->area[FRU_AREA_INTERNAL];
+	uint16_t end = length;
+	uint8_t area;
+
+	if (internal->status == FRU_AREA_ABSENT || internal->offset >= length)
+		return;
+
+	for (area = 0; area < FRU_AREA_COUNT; area++) {
+		if (index->area[area].status != FRU_AREA_ABSENT &&
+			index->area[area].offset > internal->offset && index->area[area].offset < end)
+			end = index->area[area].offset;
+	}
+
+	if (internal->offset >= end) {
+		internal->status = FRU_AREA_BAD;
+		return;
+	}
+
+	internal->length = end - internal->offset;
+	internal->status = FRU_AREA_OK;
+}
+
+/*
+walks the multirecord list to find its length.  a bad header check
+sum stops the walk, since the record length cannot be trusted.
+*/
+static void index_multirecord_area(uint8_t *buffer, uint16_t length, FRU_AREA *area)
+{
+	FRU_BUFFER image = { buffer, length };
+	FRU_MR_READER reader;
+	FRU_MR_RECORD record;
+	uint8_t data[FRU_MR_MAX_DATA];
+	uint8_t status = FRU_AREA_OK;
+	int rc;
+
+	if (area->status == FRU_AREA_ABSENT || area->offset >= length)
+		return;
+
+	fru_mr_open(&reader, area->offset, length, fru_buffer_read, &image);
+
+	while ((rc = fru_mr_next(&reader, &record)) == SUCCESS) {
+		if (fru_mr_data(&reader, &record, data) != SUCCESS)
+			status = FRU_AREA_CHKSUM;
+	}
+
+	if (rc != FRU_MR_DONE) {
+		if (record.status != FRU_AREA_CHKSUM) {
+			area->status = FRU_AREA_BAD;
+			return;
+		}
+		status = FRU_AREA_CHKSUM;
+	}
+
+	area->length = reader.next - area->offset;
+	area->status = status;
+}
+
+/*
+builds the index of every area in an eeprom image: offset, length and
+check sum status.  areas starting past the end of the image stay
+present, areas running past it are marked bad.
+*/
+int fru_index_build(uint8_t *buffer, uint16_t length, FRU_INDEX *index)
+{
+	uint8_t area;
+
+	if (buffer == NULL || index == NULL || length < sizeof(FRU_HEADER))
+		return FAILURE;
+
+	fru_index_offsets((FRU_HEADER *)buffer, index);
+
+	for (area = FRU_AREA_CHASSIS; area <= FRU_AREA_PRODUCT; area++)
+		index_info_area(buffer, length, &index->area[area]);
+
+	index_internal_area(length, index);
+	index_multirecord_area(buffer, length, &index->area[FRU_AREA_MULTIRECORD]);
+
+	return SUCCESS;
+}
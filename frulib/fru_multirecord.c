@@ -0,0 +1,205 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <string.h>
+#include "ocsfru.h"
+#include "ocslog.h"
+
+/* fixed record lengths from the platform management fru spec */
+#define MR_PSU_LEN			24
+#define MR_DC_OUTPUT_LEN	13
+
+static const char *MR_TYPE_NAMES[] = {
+	"power supply", "dc output", "dc load", "management access",
+	"base compatibility", "extended compatibility"
+};
+
+/* reads from an image in memory, context is a FRU_BUFFER */
+int fru_buffer_read(void *context, uint16_t offset, uint16_t length, uint8_t *buffer)
+{
+	FRU_BUFFER *image = (FRU_BUFFER *)context;
+
+	if (image == NULL || (uint32_t)offset + length > image->length)
+		return FAILURE;
+
+	memcpy(buffer, &image->data[offset], length);
+
+	return SUCCESS;
+}
+
+/*
+starts a walk of the multirecord list at offset.  nothing is read
+until fru_mr_next, which fetches one header at a time.
+*/
+int fru_mr_open(FRU_MR_READER *reader, uint16_t offset, uint32_t limit, FRU_READ_FN read, void *context)
+{
+	if (reader == NULL || read == NULL)
+		return FAILURE;
+
+	memset(reader, 0, sizeof(FRU_MR_READER));
+	reader->read = read;
+	reader->context = context;
+	reader->next = offset;
+	reader->limit = limit;
+	reader->done = (offset == 0);
+
+	return SUCCESS;
+}
+
+/*
+reads and verifies the next record header.  returns SUCCESS with the
+record filled in, FRU_MR_DONE after the end of list record, or FAILURE
+when the header cannot be read or trusted.  the record data is not
+read, so skipping a record costs one five byte header read.
+*/
+int fru_mr_next(FRU_MR_READER *reader, FRU_MR_RECORD *record)
+{
+	uint8_t header[FRU_MR_HEADER_LEN];
+
+	if (reader->done)
+		return FRU_MR_DONE;
+
+	memset(record, 0, sizeof(FRU_MR_RECORD));
+	record->offset = (uint16_t)reader->next;
+	record->status = FRU_AREA_BAD;
+
+	/* a failed walk cannot continue, the next header is unknown */
+	reader->done = 1;
+
+	if (reader->next + FRU_MR_HEADER_LEN > reader->limit)
+		return FAILURE;
+
+	if (reader->read(reader->context, (uint16_t)reader->next, FRU_MR_HEADER_LEN, header) != SUCCESS)
+		return FAILURE;
+
+	if (verify_chksum(header, 0, FRU_MR_HEADER_LEN - 1) != SUCCESS) {
+		record->status = FRU_AREA_CHKSUM;
+		return FAILURE;
+	}
+
+	record->type = header[0];
+	record->format = header[1] & FRU_MR_FORMAT_MASK;
+	record->last = (header[1] & FRU_MR_END_OF_LIST) != 0;
+	record->length = header[2];
+	record->data_chksum = header[3];
+
+	if (reader->next + FRU_MR_HEADER_LEN + record->length > reader->limit)
+		return FAILURE;
+
+	/* data is verified when fetched */
+	record->status = FRU_AREA_PRESENT;
+
+	reader->next += FRU_MR_HEADER_LEN + record->length;
+	reader->done = record->last;
+
+	return SUCCESS;
+}
+
+/*
+fetches the data of a record returned by fru_mr_next into data, which
+holds at least FRU_MR_MAX_DATA bytes, and checks it against the
+record check sum.
+*/
+int fru_mr_data(FRU_MR_READER *reader, FRU_MR_RECORD *record, uint8_t *data)
+{
+	if (record->status == FRU_AREA_BAD || record->status == FRU_AREA_ABSENT)
+		return FAILURE;
+
+	if (record->length > 0 &&
+		reader->read(reader->context, record->offset + FRU_MR_HEADER_LEN, record->length, data) != SUCCESS) {
+		record->status = FRU_AREA_BAD;
+		return FAILURE;
+	}
+
+	/* the record check sum is kept in the header, not after the data */
+	if (calculate_chksum(data, 0, record->length) != record->data_chksum) {
+		record->status = FRU_AREA_CHKSUM;
+		return FAILURE;
+	}
+
+	record->status = FRU_AREA_OK;
+
+	return SUCCESS;
+}
+
+/*
+walks to the next record of a type and fetches its data.  returns
+FRU_MR_DONE when the list ends without one.
+*/
+int fru_mr_find(FRU_MR_READER *reader, uint8_t type, FRU_MR_RECORD *record, uint8_t *data)
+{
+	int rc;
+
+	while ((rc = fru_mr_next(reader, record)) == SUCCESS) {
+		if (record->type == type)
+			return fru_mr_data(reader, record, data);
+	}
+
+	return rc;
+}
+
+const char *fru_mr_type_name(uint8_t type)
+{
+	if (type < sizeof(MR_TYPE_NAMES) / sizeof(MR_TYPE_NAMES[0]))
+		return MR_TYPE_NAMES[type];
+
+	if (type >= FRU_MR_OEM_FIRST)
+		return "oem";
+
+	return "reserved";
+}
+
+static uint16_t mr_word(const uint8_t *data)
+{
+	return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+/* decodes the data of a power supply information record */
+int fru_mr_psu(const FRU_MR_RECORD *record, const uint8_t *data, FRU_MR_PSU *psu)
+{
+	if (record->type != FRU_MR_POWER_SUPPLY || record->length < MR_PSU_LEN)
+		return FAILURE;
+
+	memset(psu, 0, sizeof(FRU_MR_PSU));
+
+	psu->capacity = mr_word(&data[0]) & 0x0FFF;
+	psu->peak_va = mr_word(&data[2]);
+	psu->inrush_current = data[4];
+	psu->inrush_ms = data[5];
+	psu->input_low[0] = mr_word(&data[6]);
+	psu->input_high[0] = mr_word(&data[8]);
+	psu->input_low[1] = mr_word(&data[10]);
+	psu->input_high[1] = mr_word(&data[12]);
+	psu->freq_low = data[14];
+	psu->freq_high = data[15];
+	psu->dropout_ms = data[16];
+	psu->flags = data[17];
+	psu->holdup_s = data[19] >> 4;
+	psu->peak_watts = mr_word(&data[18]) & 0x0FFF;
+
+	return SUCCESS;
+}
+
+/* decodes the data of a dc output record */
+int fru_mr_dc_output(const FRU_MR_RECORD *record, const uint8_t *data, FRU_MR_OUTPUT *output)
+{
+	if (record->type != FRU_MR_DC_OUTPUT || record->length < MR_DC_OUTPUT_LEN)
+		return FAILURE;
+
+	memset(output, 0, sizeof(FRU_MR_OUTPUT));
+
+	output->output = data[0] & 0x0F;
+	output->standby = (data[0] & 0x80) != 0;
+	output->nominal = (int16_t)mr_word(&data[1]);
+	output->deviation_low = (int16_t)mr_word(&data[3]);
+	output->deviation_high = (int16_t)mr_word(&data[5]);
+	output->ripple_mv = mr_word(&data[7]);
+	output->current_min = mr_word(&data[9]);
+	output->current_max = mr_word(&data[11]);
+
+	return SUCCESS;
+}
@@ -0,0 +1,240 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <stdio.h>
+#include <string.h>
+#include "ocsfru.h"
+#include "ocslog.h"
+
+#define SIXBIT_FIRST		0x20
+#define SIXBIT_LAST			0x5F
+#define BCD_PAD				0x0A
+
+/* bcd plus digits, 0xd to 0xf are reserved */
+static const char BCD_PLUS[] = "0123456789 -.";
+
+static int bcd_digit(char c)
+{
+	const char *digit = strchr(BCD_PLUS, c);
+
+	return (c != '\0' && digit != NULL) ? (int)(digit - BCD_PLUS) : FAILURE;
+}
+
+static char bcd_char(uint8_t nibble)
+{
+	return nibble < sizeof(BCD_PLUS) - 1 ? BCD_PLUS[nibble] : '?';
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return FAILURE;
+}
+
+/* two digits per byte, high nibble first, odd counts padded with a space */
+static uint8_t encode_bcd(const char *text, uint8_t length, uint8_t *data)
+{
+	uint8_t count = (length + 1) / 2;
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		data[i] = (uint8_t)(bcd_digit(text[i * 2]) << 4);
+		data[i] |= (uint8_t)((i * 2) + 1 < length ? bcd_digit(text[(i * 2) + 1]) : BCD_PAD);
+	}
+
+	return count;
+}
+
+/* four characters in three bytes, least significant bits first */
+static uint8_t encode_sixbit(const char *text, uint8_t length, uint8_t *data)
+{
+	uint8_t count = (uint8_t)(((length * 6) + 7) / 8);
+	uint32_t bits = 0;
+	uint8_t held = 0;
+	uint8_t idx = 0;
+	uint8_t i;
+
+	for (i = 0; i < length; i++) {
+		bits |= (uint32_t)(text[i] - SIXBIT_FIRST) << held;
+		held += 6;
+
+		while (held >= 8) {
+			data[idx++] = (uint8_t)bits;
+			bits >>= 8;
+			held -= 8;
+		}
+	}
+
+	if (held > 0)
+		data[idx] = (uint8_t)bits;
+
+	return count;
+}
+
+/*
+encodes text as a type/length byte and data in the densest type that
+holds it: bcd plus for digit strings, 6 bit ascii for upper case text
+and 8 bit ascii otherwise.  packed types pad their last byte, so text
+ending in a space stays 8 bit.  field holds FRU_FIELD_MAX + 1 bytes.
+returns the bytes written or FAILURE when the text does not fit.
+*/
+int fru_field_encode(const char *text, uint8_t length, uint8_t *field)
+{
+	uint8_t bcd = length > 0 && text[length - 1] != ' ';
+	uint8_t sixbit = bcd;
+	uint8_t type = FRU_TYPE_TEXT;
+	uint8_t count = 0;
+	uint8_t i;
+
+	for (i = 0; i < length; i++) {
+		if (bcd_digit(text[i]) < SUCCESS)
+			bcd = 0;
+		if ((uint8_t)text[i] < SIXBIT_FIRST || (uint8_t)text[i] > SIXBIT_LAST)
+			sixbit = 0;
+	}
+
+	if (bcd) {
+		type = FRU_TYPE_BCD_PLUS;
+		count = (length + 1) / 2;
+	}
+	else if (sixbit) {
+		type = FRU_TYPE_6BIT_ASCII;
+		count = (uint8_t)(((length * 6) + 7) / 8);
+	}
+	else {
+		/* a one byte text field would read as the end marker, pad it */
+		count = length == 1 ? 2 : length;
+	}
+
+	if (count > FRU_FIELD_MAX)
+		return FAILURE;
+
+	field[0] = (uint8_t)((type << FRU_TYPE_SHIFT) | count);
+
+	if (type == FRU_TYPE_BCD_PLUS)
+		encode_bcd(text, length, &field[1]);
+	else if (type == FRU_TYPE_6BIT_ASCII)
+		encode_sixbit(text, length, &field[1]);
+	else {
+		memset(&field[1], 0, count);
+		memcpy(&field[1], text, length);
+	}
+
+	return count + 1;
+}
+
+/*
+encodes hex text such as a mac address as a binary field.  ':', '-'
+and ' ' separators are skipped.  returns the bytes written or FAILURE
+when the text is not whole hex bytes.
+*/
+int fru_field_encode_binary(const char *text, uint8_t length, uint8_t *field)
+{
+	uint8_t count = 0;
+	int high = FAILURE;
+	int digit;
+	uint8_t i;
+
+	for (i = 0; i < length; i++) {
+		if (text[i] == ':' || text[i] == '-' || text[i] == ' ')
+			continue;
+
+		if ((digit = hex_digit(text[i])) < SUCCESS)
+			return FAILURE;
+
+		if (high < SUCCESS) {
+			high = digit;
+			continue;
+		}
+
+		if (count >= FRU_FIELD_MAX)
+			return FAILURE;
+
+		field[1 + count++] = (uint8_t)((high << 4) | digit);
+		high = FAILURE;
+	}
+
+	if (high >= SUCCESS)
+		return FAILURE;
+
+	field[0] = (uint8_t)((FRU_TYPE_BINARY << FRU_TYPE_SHIFT) | count);
+
+	return count + 1;
+}
+
+/* drops the padding a packed type adds to its last byte */
+static uint16_t trim_padding(char *text, uint16_t length)
+{
+	while (length > 0 && text[length - 1] == ' ')
+		length--;
+
+	text[length] = '\0';
+
+	return length;
+}
+
+/*
+decodes a field into text of at most size - 1 characters: binary as
+colon separated hex, bcd plus and 6 bit ascii unpacked, 8 bit ascii
+up to any nul padding.  returns the text length.
+*/
+uint16_t fru_field_text(const AREA_FIELD *field, char *text, uint16_t size)
+{
+	uint8_t length = fru_field_length(field);
+	const uint8_t *data = field->data;
+	uint32_t bits = 0;
+	uint8_t held = 0;
+	uint16_t out = 0;
+	uint8_t i;
+
+	if (size == 0)
+		return 0;
+
+	text[0] = '\0';
+
+	if (field->length == NULL || size < 2)
+		return 0;
+
+	switch (field->type) {
+	case FRU_TYPE_BINARY:
+		for (i = 0; i < length && out + 3 < size; i++)
+			out += sprintf(&text[out], i == 0 ? "%02x" : ":%02x", data[i]);
+		return out;
+
+	case FRU_TYPE_BCD_PLUS:
+		for (i = 0; i < length && out + 2 < size; i++) {
+			text[out++] = bcd_char(data[i] >> 4);
+			text[out++] = bcd_char(data[i] & 0x0F);
+		}
+		return trim_padding(text, out);
+
+	case FRU_TYPE_6BIT_ASCII:
+		for (i = 0; i < length && out + 1 < size; i++) {
+			bits |= (uint32_t)data[i] << held;
+			held += 8;
+
+			while (held >= 6 && out + 1 < size) {
+				text[out++] = (char)((bits & 0x3F) + SIXBIT_FIRST);
+				bits >>= 6;
+				held -= 6;
+			}
+		}
+		return trim_padding(text, out);
+
+	default:
+		for (i = 0; i < length && data[i] != '\0' && out + 1 < size; i++)
+			text[out++] = (char)data[i];
+		text[out] = '\0';
+		return out;
+	}
+}
@@ -0,0 +1,311 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __ocsfru_h
+#define __ocsfru_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* fru definitions */
+#define FRU_LANG			0x00
+#define FRU_VERSION			0x01
+#define FRU_LENGTH_MASK		0x3F
+#define FRU_TYPE_SHIFT		6
+#define FRU_AREA_STOP		0xC1
+#define FRU_AREA_UNIT		8		/* offsets and lengths are in 8 byte units */
+#define FRU_MFG_TIME_LEN	3		/* board manufacture time, minutes */
+
+/* type/length field type codes, bits 7:6 */
+#define FRU_TYPE_BINARY		0
+#define FRU_TYPE_BCD_PLUS	1
+#define FRU_TYPE_6BIT_ASCII	2
+#define FRU_TYPE_TEXT		3		/* 8 bit ascii or unicode, by language */
+#define FRU_FIELD_DONE		1		/* fru_field_next: end of fields */
+#define FRU_FIELD_MAX		FRU_LENGTH_MASK	/* data bytes in a field */
+#define FRU_FIELD_TEXT_LEN	192		/* decoded text of any field, with nul */
+#define FRU_MAX_CUSTOM		8		/* custom fields kept per area */
+
+/* areas in common header order */
+enum fru_area_id
+{
+	FRU_AREA_INTERNAL = 0,
+	FRU_AREA_CHASSIS,
+	FRU_AREA_BOARD,
+	FRU_AREA_PRODUCT,
+	FRU_AREA_MULTIRECORD,
+	FRU_AREA_COUNT
+};
+
+/* area index status */
+#define FRU_AREA_ABSENT		0	/* zero offset in the common header */
+#define FRU_AREA_PRESENT	1	/* offset known, area not yet read */
+#define FRU_AREA_OK			2	/* length known, check sum good or not used */
+#define FRU_AREA_CHKSUM		3	/* check sum mismatch */
+#define FRU_AREA_BAD		4	/* runs past the image or is malformed */
+
+/* multirecord header */
+#define FRU_MR_HEADER_LEN	5
+#define FRU_MR_END_OF_LIST	0x80
+#define FRU_MR_FORMAT_MASK	0x0F
+#define FRU_MR_DONE			1		/* fru_mr_next: no more records */
+
+/* multirecord types */
+#define FRU_MR_POWER_SUPPLY	0x00
+#define FRU_MR_DC_OUTPUT	0x01
+#define FRU_MR_DC_LOAD		0x02
+#define FRU_MR_MGMT_ACCESS	0x03
+#define FRU_MR_BASE_COMPAT	0x04
+#define FRU_MR_EXT_COMPAT	0x05
+#define FRU_MR_OEM_FIRST	0xC0
+#define FRU_MR_MAX_DATA		255
+
+#define PACK( __Declaration__ ) __Declaration__ __attribute__((__packed__))
+/*#define PACK( __Declaration__ ) __pragma( pack(push, 1) ) __Declaration__ __pragma( pack(pop) )*/
+
+/* fru eeprom header format */
+PACK(typedef struct fru_header
+{
+	uint8_t        commonheader;
+	uint8_t        areaoffset;
+	uint8_t        chassis;
+	uint8_t        board;
+	uint8_t        product;
+	uint8_t        multirecord;
+	uint8_t        pad;
+	uint8_t		   checksum;
+}) FRU_HEADER;
+
+/* location and state of one area */
+typedef struct fru_area
+{
+	uint16_t		offset;		/* bytes from the start of the eeprom */
+	uint16_t		length;		/* bytes, including header and check sum */
+	uint8_t			status;
+} FRU_AREA;
+
+/* every area named by the common header, built in one pass */
+typedef struct fru_index
+{
+	uint8_t			header_status;	/* FRU_AREA_OK or FRU_AREA_CHKSUM */
+	FRU_AREA		area[FRU_AREA_COUNT];
+} FRU_INDEX;
+
+/*
+reads length bytes at an eeprom offset into buffer, from the device
+or from an image.  returns SUCCESS or FAILURE.
+*/
+typedef int (*FRU_READ_FN)(void *context, uint16_t offset, uint16_t length, uint8_t *buffer);
+
+/* image in memory, the context of fru_buffer_read */
+typedef struct fru_buffer
+{
+	uint8_t			*data;
+	uint16_t		length;
+} FRU_BUFFER;
+
+/* one multirecord, from its header */
+typedef struct fru_mr_record
+{
+	uint16_t		offset;			/* of the record header */
+	uint8_t			type;
+	uint8_t			format;
+	uint8_t			last;			/* end of list flag */
+	uint8_t			length;			/* data bytes after the header */
+	uint8_t			data_chksum;
+	uint8_t			status;			/* FRU_AREA_OK, CHKSUM or BAD */
+} FRU_MR_RECORD;
+
+/* walks a multirecord list one header at a time */
+typedef struct fru_mr_reader
+{
+	FRU_READ_FN		read;
+	void			*context;
+	uint32_t		next;			/* offset of the next header */
+	uint32_t		limit;			/* records must end before this */
+	uint8_t			done;
+} FRU_MR_READER;
+
+/* power supply information, record type 0x00 */
+typedef struct fru_mr_psu
+{
+	uint16_t		capacity;		/* watts */
+	uint16_t		peak_va;
+	uint8_t			inrush_current;	/* amps */
+	uint8_t			inrush_ms;
+	uint16_t		input_low[2];	/* input voltage ranges, 10 mV */
+	uint16_t		input_high[2];
+	uint8_t			freq_low;		/* hz */
+	uint8_t			freq_high;
+	uint8_t			dropout_ms;
+	uint8_t			flags;
+	uint8_t			holdup_s;
+	uint16_t		peak_watts;
+} FRU_MR_PSU;
+
+/* dc output, record type 0x01 */
+typedef struct fru_mr_dc_output
+{
+	uint8_t			output;			/* output number */
+	uint8_t			standby;
+	int16_t			nominal;		/* 10 mV */
+	int16_t			deviation_low;	/* 10 mV */
+	int16_t			deviation_high;	/* 10 mV */
+	uint16_t		ripple_mv;
+	uint16_t		current_min;	/* mA */
+	uint16_t		current_max;	/* mA */
+} FRU_MR_OUTPUT;
+
+/* fru area common header */
+PACK(typedef struct area_header
+{
+	uint8_t        version : 4;
+	uint8_t        length;
+	uint8_t        languagecode;
+}) AREA_HEADER;
+
+/* fru area field, type is decoded from the type/length byte */
+PACK(typedef struct fru_field
+{
+	uint8_t			*length;
+	uint8_t         *data;
+	uint8_t			type;
+}) AREA_FIELD;
+
+/*
+walks the type/length fields of a chassis, board or product area up
+to the end of fields marker.  images written by older ocs-fru have a
+zero byte after each field, which begin detects.
+*/
+typedef struct fru_field_iter
+{
+	uint8_t			*buffer;
+	uint16_t		idx;
+	uint16_t		end;			/* the area check sum byte */
+	uint8_t			gap;			/* bytes between fields */
+	uint8_t			count;			/* fields returned so far */
+} FRU_FIELD_ITER;
+
+/*
+walks the fields of an area through a FRU_READ_FN without reading the
+area: one type/length byte per field, so only the fields wanted cross
+the bus.  the area check sum is not verified.
+*/
+typedef struct fru_field_reader
+{
+	FRU_READ_FN		read;
+	void			*context;
+	uint32_t		next;			/* offset of the next type/length byte */
+	uint32_t		end;			/* the area check sum byte */
+	int16_t			ahead;			/* type/length byte at next when already read, or -1 */
+	uint8_t			gap;			/* bytes between fields */
+	uint8_t			count;			/* fields returned so far */
+	uint8_t			done;
+} FRU_FIELD_READER;
+
+/* a field found by fru_field_locate, its data is not read */
+typedef struct fru_field_loc
+{
+	uint16_t		offset;			/* of the data */
+	uint8_t			type_length;
+	uint8_t			type;
+} FRU_FIELD_LOC;
+
+/* fru chassis info area, which has a chassis type instead of a language */
+PACK(typedef struct fru_chassis_info
+{
+	AREA_HEADER		header;
+	uint8_t			type;
+	AREA_FIELD		part;
+	AREA_FIELD		serial;
+	uint8_t			custom_count;
+	AREA_FIELD		custom[FRU_MAX_CUSTOM];
+}) FRU_CHASSIS_INFO;
+
+/* fru board info area */
+PACK(typedef struct fru_board_info
+{
+	AREA_HEADER 	header;
+	uint8_t			mfgdatetime[3];
+	AREA_FIELD      manufacture;
+	AREA_FIELD      name;
+	AREA_FIELD		serial;
+	AREA_FIELD		part;
+	AREA_FIELD		fruid;
+	AREA_FIELD		address1;
+	AREA_FIELD		address2;
+	AREA_FIELD		boardver;
+	AREA_FIELD		build;
+	uint8_t			custom_count;
+	AREA_FIELD		custom[FRU_MAX_CUSTOM];
+}) FRU_BOARD_INFO;
+
+/* fru product info area */
+PACK(typedef struct fru_product_info
+{
+	AREA_HEADER		header;
+	AREA_FIELD      manufacture;
+	AREA_FIELD      productname;
+	AREA_FIELD		productversion;
+	AREA_FIELD		serial;
+	AREA_FIELD		assettag;
+	AREA_FIELD		fruid;
+	AREA_FIELD		subproduct;
+	AREA_FIELD		build;
+	uint8_t			custom_count;
+	AREA_FIELD		custom[FRU_MAX_CUSTOM];
+}) FRU_PRODUCT_INFO;
+
+/*
+decoded view of an eeprom image.  fields point into the buffer passed
+to fru_decode, so the buffer must outlive the view.
+*/
+typedef struct fru_info
+{
+	FRU_HEADER			header;
+	FRU_INDEX			index;
+	uint8_t				has_chassis;
+	uint8_t				has_board;
+	uint8_t				has_product;
+	FRU_CHASSIS_INFO	chassis;
+	FRU_BOARD_INFO		board;
+	FRU_PRODUCT_INFO	product;
+} FRU_INFO;
+
+int calculate_chksum(uint8_t *buffer, uint16_t offset, uint16_t end_pos);
+int verify_chksum(uint8_t *buffer, uint16_t offset, uint16_t end_pos);
+void fru_index_offsets(const FRU_HEADER *header, FRU_INDEX *index);
+int fru_index_build(uint8_t *buffer, uint16_t length, FRU_INDEX *index);
+const char *fru_area_name(uint8_t area);
+int fru_buffer_read(void *context, uint16_t offset, uint16_t length, uint8_t *buffer);
+int fru_mr_open(FRU_MR_READER *reader, uint16_t offset, uint32_t limit, FRU_READ_FN read, void *context);
+int fru_mr_next(FRU_MR_READER *reader, FRU_MR_RECORD *record);
+int fru_mr_data(FRU_MR_READER *reader, FRU_MR_RECORD *record, uint8_t *data);
+int fru_mr_find(FRU_MR_READER *reader, uint8_t type, FRU_MR_RECORD *record, uint8_t *data);
+const char *fru_mr_type_name(uint8_t type);
+int fru_mr_psu(const FRU_MR_RECORD *record, const uint8_t *data, FRU_MR_PSU *psu);
+int fru_mr_dc_output(const FRU_MR_RECORD *record, const uint8_t *data, FRU_MR_OUTPUT *output);
+int fru_field_begin(FRU_FIELD_ITER *iter, uint8_t *buffer, const FRU_AREA *area, uint16_t fixed);
+int fru_field_next(FRU_FIELD_ITER *iter, AREA_FIELD *field);
+int fru_field_open(FRU_FIELD_READER *reader, uint16_t area_offset, uint16_t fixed, FRU_READ_FN read, void *context);
+int fru_field_locate(FRU_FIELD_READER *reader, FRU_FIELD_LOC *loc);
+int fru_decode(uint8_t *buffer, uint16_t length, FRU_INFO *info);
+uint8_t fru_field_length(const AREA_FIELD *field);
+uint8_t fru_field_type(const AREA_FIELD *field);
+int fru_field_encode(const char *text, uint8_t length, uint8_t *field);
+int fru_field_encode_binary(const char *text, uint8_t length, uint8_t *field);
+uint16_t fru_field_text(const AREA_FIELD *field, char *text, uint16_t size);
+uint32_t fru_mfg_minutes(const FRU_BOARD_INFO *board);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__ocsfru_h
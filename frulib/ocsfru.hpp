@@ -0,0 +1,98 @@
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//
+// This program is free software; you can redistribute it
+// and/or modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef __ocsfru_hpp
+#define __ocsfru_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "ocsfru.h"
+
+namespace ocsfru {
+
+/* raw field data as a view into the decoded buffer */
+inline std::string_view field_data(const AREA_FIELD &f) noexcept
+{
+	if (f.data == nullptr)
+		return std::string_view();
+
+	return std::string_view(reinterpret_cast<const char *>(f.data), fru_field_length(&f));
+}
+
+/* field text, unpacked from its encoding type */
+inline std::string field(const AREA_FIELD &f)
+{
+	char text[FRU_FIELD_TEXT_LEN];
+
+	return std::string(text, fru_field_text(&f, text, sizeof(text)));
+}
+
+/*
+decoded eeprom image.  fields point into the buffer given to the
+constructor, which must outlive this object; the accessors return
+the field text.
+*/
+class image
+{
+public:
+	image(uint8_t *buffer, uint16_t length) noexcept
+		: status_(fru_decode(buffer, length, &info_)) {}
+
+	bool ok() const noexcept { return status_ == 0; }
+	const FRU_INFO &info() const noexcept { return info_; }
+	const FRU_AREA &area(fru_area_id id) const noexcept { return info_.index.area[id]; }
+
+	bool has_chassis() const noexcept { return info_.has_chassis != 0; }
+	uint8_t chassis_type() const noexcept { return info_.chassis.type; }
+	std::string chassis_part() const { return field(info_.chassis.part); }
+	std::string chassis_serial() const { return field(info_.chassis.serial); }
+
+	bool has_board() const noexcept { return info_.has_board != 0; }
+	uint32_t board_mfg_minutes() const noexcept { return fru_mfg_minutes(&info_.board); }
+	std::string board_manufacturer() const { return field(info_.board.manufacture); }
+	std::string board_name() const { return field(info_.board.name); }
+	std::string board_serial() const { return field(info_.board.serial); }
+	std::string board_part() const { return field(info_.board.part); }
+	std::string board_fruid() const { return field(info_.board.fruid); }
+	std::string board_address1() const { return field(info_.board.address1); }
+	std::string board_address2() const { return field(info_.board.address2); }
+	std::string board_version() const { return field(info_.board.boardver); }
+	std::string board_build() const { return field(info_.board.build); }
+
+	bool has_product() const noexcept { return info_.has_product != 0; }
+	std::string product_manufacturer() const { return field(info_.product.manufacture); }
+	std::string product_name() const { return field(info_.product.productname); }
+	std::string product_version() const { return field(info_.product.productversion); }
+	std::string product_serial() const { return field(info_.product.serial); }
+	std::string product_assettag() const { return field(info_.product.assettag); }
+	std::string product_fruid() const { return field(info_.product.fruid); }
+	std::string product_subproduct() const { return field(info_.product.subproduct); }
+	std::string product_build() const { return field(info_.product.build); }
+
+	/* fields after the known ones of each area */
+	uint8_t chassis_custom_count() const noexcept { return info_.chassis.custom_count; }
+	std::string chassis_custom(uint8_t i) const { return custom(info_.chassis.custom, info_.chassis.custom_count, i); }
+	uint8_t board_custom_count() const noexcept { return info_.board.custom_count; }
+	std::string board_custom(uint8_t i) const { return custom(info_.board.custom, info_.board.custom_count, i); }
+	uint8_t product_custom_count() const noexcept { return info_.product.custom_count; }
+	std::string product_custom(uint8_t i) const { return custom(info_.product.custom, info_.product.custom_count, i); }
+
+private:
+	static std::string custom(const AREA_FIELD *fields, uint8_t count, uint8_t i)
+	{
+		return i < count ? field(fields[i]) : std::string();
+	}
+
+	FRU_INFO info_;
+	int status_;
+};
+
+} // namespace ocsfru
+
+#endif //__ocsfru_hpp